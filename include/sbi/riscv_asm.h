@@ -190,6 +190,10 @@ int is_pmp_entry_mapped(unsigned long entry);
 int pmp_set(unsigned int n, unsigned long prot, unsigned long addr,
 	    unsigned long log2len);
 
+/* Set pmp entry n as TOR range [addr, addr + size) using pmpaddr(n-1) */
+int pmp_set_tor(unsigned int n, unsigned long prot, unsigned long addr,
+		unsigned long size);
+
 int pmp_get(unsigned int n, unsigned long *prot_out, unsigned long *addr_out,
 	    unsigned long *log2len);
 
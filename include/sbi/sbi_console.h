@@ -52,10 +52,50 @@ int __printf(1, 2) sbi_dprintf(const char *format, ...);
 
 void __printf(1, 2) __attribute__((noreturn)) sbi_panic(const char *format, ...);
 
+/**
+ * Write a burst of characters to an empty TX FIFO
+ *
+ * Helper for the console_puts() of drivers which can tell when their TX
+ * FIFO is empty. Waits once for the FIFO to drain and then writes up to
+ * fifo_size bytes, converting "\n" to "\r\n" without splitting the pair.
+ *
+ * @param str characters to write
+ * @param len number of characters to write
+ * @param fifo_size depth of the TX FIFO in bytes
+ * @param wait_empty function waiting until the TX FIFO is empty
+ * @param write function writing one byte to the TX FIFO
+ *
+ * @return number of characters of str consumed
+ */
+unsigned long sbi_console_puts_fifo(const char *str, unsigned long len,
+				    u32 fifo_size, void (*wait_empty)(void),
+				    void (*write)(char ch));
+
 const struct sbi_console_device *sbi_console_get_device(void);
 
 void sbi_console_set_device(const struct sbi_console_device *dev);
 
+/**
+ * Buffer console input from a wired interrupt taken in M-mode
+ *
+ * Called by console drivers which keep their receive interrupt disabled
+ * until rx_enable() is called, after the interrupt has been routed to
+ * M-mode. If routing fails then rx_enable() is never called and console
+ * input stays polled.
+ *
+ * @param hwirq wired interrupt number of the console device
+ * @param parent_addr MMIO base address of the interrupt controller
+ * which the interrupt is wired to
+ * @param rx_enable function which enables the receive interrupt
+ *
+ * @return 0 on success and negative error code on failure
+ */
+int sbi_console_set_rx_hwirq(u32 hwirq, unsigned long parent_addr,
+			     void (*rx_enable)(void));
+
+/** Synchronously write out the buffered output of all HARTs */
+void sbi_console_flush(void);
+
 struct sbi_scratch;
 
 int sbi_console_init(struct sbi_scratch *scratch);
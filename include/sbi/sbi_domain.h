@@ -159,6 +159,16 @@ struct sbi_domain_memregion {
 /** Maximum number of domains */
 #define SBI_DOMAIN_MAX_INDEX			32
 
+/** Address interval with the flags of the memory region effective in it */
+struct sbi_domain_addr_interval {
+	/** First address of the interval */
+	unsigned long start;
+	/** Last address of the interval */
+	unsigned long end;
+	/** Flags of the effective memory region */
+	unsigned long flags;
+};
+
 /** Representation of OpenSBI domain */
 struct sbi_domain {
 	/**
@@ -190,8 +200,26 @@ struct sbi_domain {
 	bool system_reset_allowed;
 	/** Is domain allowed to suspend the system */
 	bool system_suspend_allowed;
+	/** Timer slack in microseconds applied to S-mode timer deadlines */
+	u32 timer_slack_us;
+	/** Bitmap of indices of the domains this domain may enter */
+	u32 enter_domains;
 	/** Identifies whether to include the firmware region */
 	bool fw_region_inited;
+	/**
+	 * Non-overlapping address intervals sorted by address which
+	 * flatten the memory regions for fast address checks
+	 * Note: This is set by sbi_domain_finalize() in the coldboot path
+	 */
+	struct sbi_domain_addr_interval *intervals;
+	/** Number of address intervals */
+	u32 interval_count;
+	/**
+	 * Per-HART contexts of this domain indexed by HART index
+	 * Note: This is allocated by sbi_domain_context_init() in the
+	 * coldboot path
+	 */
+	struct sbi_context **hartindex_to_context_table;
 };
 
 /** The root domain instance */
@@ -200,9 +228,12 @@ extern struct sbi_domain root;
 /** Get pointer to sbi_domain from HART index */
 struct sbi_domain *sbi_hartindex_to_domain(u32 hartindex);
 
+/** Update HART local pointer to point to specified domain */
+void sbi_update_hartindex_to_domain(u32 hartindex, struct sbi_domain *dom);
+
 /** Get pointer to sbi_domain for current HART */
 #define sbi_domain_thishart_ptr() \
-	sbi_hartindex_to_domain(sbi_hartid_to_hartindex(current_hartid()))
+	sbi_hartindex_to_domain(current_hartindex())
 
 /** Index to domain table */
 extern struct sbi_domain *domidx_to_domain_table[];
@@ -0,0 +1,95 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * Copyright (c) 2026 The OpenSBI Authors.
+ *
+ * Authors:
+ *   agent <agent@local>
+ */
+
+#ifndef __SBI_DOMAIN_CONTEXT_H__
+#define __SBI_DOMAIN_CONTEXT_H__
+
+#include <sbi/sbi_types.h>
+#include <sbi/sbi_trap.h>
+
+struct sbi_domain;
+
+/** Context representation for a HART within a domain */
+struct sbi_context {
+	/** Trap-related states such as GPRs, mepc, and mstatus */
+	struct sbi_trap_regs regs;
+
+	/** Supervisor interrupt enable register */
+	unsigned long sie;
+	/** Supervisor trap vector base address register */
+	unsigned long stvec;
+	/** Supervisor scratch register for temporary storage */
+	unsigned long sscratch;
+	/** Supervisor exception program counter register */
+	unsigned long sepc;
+	/** Supervisor cause register */
+	unsigned long scause;
+	/** Supervisor trap value register */
+	unsigned long stval;
+	/** Supervisor interrupt pending register */
+	unsigned long sip;
+	/** Supervisor address translation and protection register */
+	unsigned long satp;
+	/** Counter-enable register */
+	unsigned long scounteren;
+	/** Supervisor environment configuration register */
+	unsigned long senvcfg;
+	/** S-mode timer deadline (-1ULL if none) */
+	u64 timer_deadline;
+	/** Whether the S-mode timer interrupt is pending */
+	bool timer_pending;
+
+	/** Reference to the owning domain */
+	struct sbi_domain *dom;
+	/** Previous context (caller) to jump to during context exits */
+	struct sbi_context *prev_ctx;
+	/** Is context initialized and runnable */
+	bool initialized;
+};
+
+/**
+ * Request a switch of the current HART to the context of the specified
+ * domain. The switch happens once the current SBI call has completed,
+ * and the domain is started from its next stage entry point if it has
+ * not run on this HART before.
+ *
+ * @param dom pointer to target domain
+ * @return 0 on success and negative error code on failure
+ */
+int sbi_domain_context_enter(struct sbi_domain *dom);
+
+/**
+ * Request a switch of the current HART back to the context which
+ * entered the current domain. The switch happens once the current SBI
+ * call has completed.
+ *
+ * @return 0 on success and negative error code on failure
+ */
+int sbi_domain_context_exit(void);
+
+/**
+ * Initialize domain context support (cold boot only, after all domains
+ * have been registered)
+ *
+ * @return 0 on success and negative error code on failure
+ */
+int sbi_domain_context_init(void);
+
+#ifdef CONFIG_SBI_ECALL_DOMAIN
+/**
+ * Perform a domain context switch requested by the current SBI call
+ *
+ * @param regs pointer to trap registers holding the completed SBI call
+ */
+void sbi_domain_context_process(struct sbi_trap_regs *regs);
+#else
+static inline void sbi_domain_context_process(struct sbi_trap_regs *regs) { }
+#endif
+
+#endif
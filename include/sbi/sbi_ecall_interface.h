@@ -103,6 +103,7 @@
 #define SBI_EXT_PMU_COUNTER_STOP	0x4
 #define SBI_EXT_PMU_COUNTER_FW_READ	0x5
 #define SBI_EXT_PMU_COUNTER_FW_READ_HI	0x6
+#define SBI_EXT_PMU_SNAPSHOT_SET_SHMEM	0x7
 
 /** General pmu event codes specified in SBI PMU extension */
 enum sbi_pmu_hw_generic_events_t {
@@ -241,9 +242,11 @@ enum sbi_pmu_ctr_type {
 
 /* Flags defined for counter start function */
 #define SBI_PMU_START_FLAG_SET_INIT_VALUE (1 << 0)
+#define SBI_PMU_START_FLAG_INIT_SNAPSHOT (1 << 1)
 
 /* Flags defined for counter stop function */
 #define SBI_PMU_STOP_FLAG_RESET (1 << 0)
+#define SBI_PMU_STOP_FLAG_TAKE_SNAPSHOT (1 << 1)
 
 /* SBI function IDs for DBCN extension */
 #define SBI_EXT_DBCN_CONSOLE_WRITE		0x0
@@ -263,6 +266,10 @@ enum sbi_pmu_ctr_type {
 #define SBI_EXT_CPPC_READ_HI			0x2
 #define SBI_EXT_CPPC_WRITE			0x3
 
+/* SBI function IDs for OpenSBI firmware specific extension */
+#define SBI_EXT_OPENSBI_DOMAIN_ENTER		0x0
+#define SBI_EXT_OPENSBI_DOMAIN_EXIT		0x1
+
 enum sbi_cppc_reg_id {
 	SBI_CPPC_HIGHEST_PERF		= 0x00000000,
 	SBI_CPPC_NOMINAL_PERF		= 0x00000001,
@@ -298,6 +305,9 @@ enum sbi_cppc_reg_id {
 #define SBI_EXT_VENDOR_END			0x09FFFFFF
 #define SBI_EXT_FIRMWARE_START			0x0A000000
 #define SBI_EXT_FIRMWARE_END			0x0AFFFFFF
+/* Firmware specific extension of OpenSBI (needs SBI_OPENSBI_IMPID) */
+#define SBI_EXT_OPENSBI				\
+	(SBI_EXT_FIRMWARE_START + SBI_OPENSBI_IMPID)
 
 /* SBI return error codes */
 #define SBI_SUCCESS				0
@@ -309,8 +319,9 @@ enum sbi_cppc_reg_id {
 #define SBI_ERR_ALREADY_AVAILABLE		-6
 #define SBI_ERR_ALREADY_STARTED			-7
 #define SBI_ERR_ALREADY_STOPPED			-8
+#define SBI_ERR_NO_SHMEM			-9
 
-#define SBI_LAST_ERR				SBI_ERR_ALREADY_STOPPED
+#define SBI_LAST_ERR				SBI_ERR_NO_SHMEM
 
 /* clang-format on */
 
@@ -42,6 +42,10 @@ enum sbi_hart_extensions {
 	SBI_HART_EXT_ZIHPM,
 	/** Hart has Smcntrpmf extension */
 	SBI_HART_EXT_SMCNTRPMF,
+	/** Hart has Smcdeleg extension */
+	SBI_HART_EXT_SMCDELEG,
+	/** Hart has Ssccfg extension */
+	SBI_HART_EXT_SSCCFG,
 
 	/** Maximum index of Hart extension */
 	SBI_HART_EXT_MAX,
@@ -53,14 +57,24 @@ enum sbi_hart_extensions {
  * such that M-mode doesn't have access to S/U-mode memory.
  *
  * To give M-mode R/W access to the shared memory between M and
- * S/U-mode, first entry is reserved. It is disabled at boot.
- * When shared memory access is required, the physical address
- * should be programmed into the first PMP entry with R/W
- * permissions to the M-mode. Once the work is done, it should be
- * unmapped. sbi_hart_map_saddr/sbi_hart_unmap_saddr function
- * pair should be used to map/unmap the shared memory.
+ * S/U-mode, the first SBI_SMEPMP_RESV_COUNT entries are reserved.
+ * They are disabled at boot. When shared memory access is required,
+ * the physical address is programmed into one of the reserved PMP
+ * entries with R/W permissions to the M-mode. The sbi_hart_map_saddr/
+ * sbi_hart_unmap_saddr function pair should be used around accesses
+ * to the shared memory. Shared memory registered by S-mode for repeated
+ * use (such as the PMU snapshot) is mapped with
+ * sbi_hart_map_registered_saddr instead. Its window stays programmed
+ * after sbi_hart_unmap_saddr until it is evicted or invalidated using
+ * sbi_hart_invalidate_saddr, provided that S-mode has R/W access to the
+ * whole window anyway.
  */
 #define SBI_SMEPMP_RESV_ENTRY		0
+#ifdef CONFIG_SBI_SMEPMP_SADDR_WINDOWS
+#define SBI_SMEPMP_RESV_COUNT		CONFIG_SBI_SMEPMP_SADDR_WINDOWS
+#else
+#define SBI_SMEPMP_RESV_COUNT		2
+#endif
 
 struct sbi_hart_features {
 	bool detected;
@@ -90,10 +104,15 @@ void sbi_hart_delegation_dump(struct sbi_scratch *scratch,
 unsigned int sbi_hart_pmp_count(struct sbi_scratch *scratch);
 unsigned long sbi_hart_pmp_granularity(struct sbi_scratch *scratch);
 unsigned int sbi_hart_pmp_addrbits(struct sbi_scratch *scratch);
+unsigned int sbi_hart_pmp_used(struct sbi_scratch *scratch,
+			       unsigned int *saved);
 unsigned int sbi_hart_mhpm_bits(struct sbi_scratch *scratch);
 int sbi_hart_pmp_configure(struct sbi_scratch *scratch);
+int sbi_hart_pmp_switch(struct sbi_scratch *scratch);
 int sbi_hart_map_saddr(unsigned long base, unsigned long size);
+int sbi_hart_map_registered_saddr(unsigned long base, unsigned long size);
 int sbi_hart_unmap_saddr(void);
+void sbi_hart_invalidate_saddr(unsigned long addr, unsigned long size);
 int sbi_hart_priv_version(struct sbi_scratch *scratch);
 void sbi_hart_get_priv_version_str(struct sbi_scratch *scratch,
 				   char *version_str, int nvstr);
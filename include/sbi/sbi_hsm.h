@@ -12,6 +12,29 @@
 
 #include <sbi/sbi_types.h>
 
+#ifdef CONFIG_SBI_HSM_IDLE_GOVERNOR
+/**
+ * Suspend type asking the firmware idle governor to pick the idle state
+ *
+ * This takes the last platform specific non-retentive suspend type so
+ * the caller must provide a resume address as for non-retentive suspend.
+ */
+#define SBI_HSM_SUSPEND_GOVERNED	SBI_HSM_SUSPEND_NON_RET_LAST
+#endif
+
+/** Maximum number of idle states known to the firmware idle governor */
+#define SBI_HSM_IDLE_STATE_MAX		8
+
+/** Idle state description for the firmware idle governor */
+struct sbi_hsm_idle_state {
+	/** Suspend type passed to hart_suspend() for this state */
+	u32 suspend_type;
+	/** Expected entry plus exit latency in microseconds */
+	u32 latency_us;
+	/** Minimum residency in microseconds for this state to pay off */
+	u32 min_residency_us;
+};
+
 /** Hart state managment device */
 struct sbi_hsm_device {
 	/** Name of the hart state managment device */
@@ -49,6 +72,15 @@ struct sbi_hsm_device {
 	 * non-retentive suspend.
 	 */
 	void (*hart_resume)(void);
+
+	/**
+	 * Idle states for the firmware idle governor ordered from the
+	 * shallowest to the deepest (at most SBI_HSM_IDLE_STATE_MAX).
+	 */
+	const struct sbi_hsm_idle_state *idle_states;
+
+	/** Number of entries in idle_states */
+	u32 idle_state_count;
 };
 
 struct sbi_domain;
@@ -69,7 +101,7 @@ void sbi_hsm_hart_resume_start(struct sbi_scratch *scratch);
 void __noreturn sbi_hsm_hart_resume_finish(struct sbi_scratch *scratch,
 					   u32 hartid);
 int sbi_hsm_hart_suspend(struct sbi_scratch *scratch, u32 suspend_type,
-			 ulong raddr, ulong rmode, ulong arg1);
+			 ulong raddr, ulong rmode, ulong arg1, ulong exp_sleep);
 bool sbi_hsm_hart_change_state(struct sbi_scratch *scratch, long oldstate,
 			       long newstate);
 int __sbi_hsm_hart_get_state(u32 hartid);
@@ -15,6 +15,27 @@
 struct sbi_scratch;
 struct sbi_trap_regs;
 
+/** Maximum number of wired interrupts handled in M-mode */
+#define SBI_IRQCHIP_MAX_HWIRQ_HANDLERS	4
+
+/** Interrupt controller able to deliver wired interrupts to M-mode */
+struct sbi_irqchip_device {
+	/** Name of the irqchip device */
+	char name[32];
+
+	/**
+	 * Enable or disable a wired interrupt for M-mode of current HART
+	 * provided the interrupt controller at parent_addr is this device
+	 */
+	int (*hwirq_route)(unsigned long parent_addr, u32 hwirq, bool enable);
+
+	/** Claim a pending wired interrupt for M-mode of current HART */
+	u32 (*hwirq_claim)(void);
+
+	/** Signal completion of a claimed wired interrupt */
+	void (*hwirq_complete)(u32 hwirq);
+};
+
 /**
  * Set external interrupt handling function
  *
@@ -35,6 +56,36 @@ void sbi_irqchip_set_irqfn(int (*fn)(struct sbi_trap_regs *regs));
  */
 int sbi_irqchip_process(struct sbi_trap_regs *regs);
 
+/** Get current irqchip device */
+const struct sbi_irqchip_device *sbi_irqchip_get_device(void);
+
+/** Register irqchip device */
+void sbi_irqchip_set_device(const struct sbi_irqchip_device *dev);
+
+/**
+ * Register an M-mode handler for a wired interrupt
+ *
+ * The interrupt is routed to M-mode of the cold boot HART when interrupt
+ * controllers are initialized, so this must be called before
+ * sbi_irqchip_init() on the cold boot path. The handler is called with
+ * the claimed interrupt number and must quiesce the interrupt source.
+ * The interrupt source must stay disabled until the optional routed
+ * callback is called, which only happens once routing has succeeded.
+ *
+ * @param hwirq wired interrupt number
+ * @param parent_addr MMIO base address of the interrupt controller
+ * which the interrupt is wired to
+ * @param fn handler function
+ * @param routed function called after the interrupt is routed (optional)
+ * @param priv opaque pointer passed to the handler and routed functions
+ *
+ * @return 0 on success and negative error code on failure
+ */
+int sbi_irqchip_register_hwirq_handler(u32 hwirq, unsigned long parent_addr,
+				       int (*fn)(u32 hwirq, void *priv),
+				       void (*routed)(u32 hwirq, void *priv),
+				       void *priv);
+
 /** Initialize interrupt controllers */
 int sbi_irqchip_init(struct sbi_scratch *scratch, bool cold_boot);
 
@@ -60,8 +60,14 @@ enum sbi_platform_features {
 	/** Platform has fault delegation support */
 	SBI_PLATFORM_HAS_MFAULTS_DELEGATION = (1 << 1),
 
+	/**
+	 * HARTs with the same mvendorid, marchid, mimpid and misa are
+	 * identical and may share probed features (opt-in)
+	 */
+	SBI_PLATFORM_HAS_HART_FEATURE_CACHE = (1 << 2),
+
 	/** Last index of Platform features*/
-	SBI_PLATFORM_HAS_LAST_FEATURE = SBI_PLATFORM_HAS_MFAULTS_DELEGATION,
+	SBI_PLATFORM_HAS_LAST_FEATURE = SBI_PLATFORM_HAS_HART_FEATURE_CACHE,
 };
 
 /** Default feature set for a platform */
@@ -146,9 +152,26 @@ struct sbi_platform_operations {
 /** Platform default per-HART stack size for exception/interrupt handling */
 #define SBI_PLATFORM_DEFAULT_HART_STACK_SIZE	8192
 
+/** Per-HART heap space used by console log rings */
+#ifdef CONFIG_SBI_CONSOLE_ASYNC
+#define SBI_PLATFORM_CONSOLE_RING_HEAP_SIZE	\
+	(1 << CONFIG_SBI_CONSOLE_RING_SHIFT)
+#else
+#define SBI_PLATFORM_CONSOLE_RING_HEAP_SIZE	0
+#endif
+
+/** Per-HART heap space used by console binary logs */
+#ifdef CONFIG_SBI_CONSOLE_BINLOG
+#define SBI_PLATFORM_CONSOLE_BINLOG_HEAP_SIZE	\
+	(0x40 + (__SIZEOF_POINTER__ << CONFIG_SBI_CONSOLE_BINLOG_SHIFT))
+#else
+#define SBI_PLATFORM_CONSOLE_BINLOG_HEAP_SIZE	0
+#endif
+
 /** Platform default heap size */
 #define SBI_PLATFORM_DEFAULT_HEAP_SIZE(__num_hart)	\
-					(0x8000 + 0x800 * (__num_hart))
+	(0x8000 + (0x800 + SBI_PLATFORM_CONSOLE_RING_HEAP_SIZE +	\
+		   SBI_PLATFORM_CONSOLE_BINLOG_HEAP_SIZE) * (__num_hart))
 
 /** Representation of a platform */
 struct sbi_platform {
@@ -262,6 +285,10 @@ _Static_assert(
 #define sbi_platform_has_mfaults_delegation(__p) \
 	((__p)->features & SBI_PLATFORM_HAS_MFAULTS_DELEGATION)
 
+/** Check whether identical HARTs may share probed features */
+#define sbi_platform_has_hart_feature_cache(__p) \
+	((__p)->features & SBI_PLATFORM_HAS_HART_FEATURE_CACHE)
+
 /**
  * Get the platform features in string format
  *
@@ -21,9 +21,60 @@ struct sbi_scratch;
 /* Counter related macros */
 #define SBI_PMU_FW_CTR_MAX 16
 #define SBI_PMU_HW_CTR_MAX 32
-#define SBI_PMU_CTR_MAX	   (SBI_PMU_HW_CTR_MAX + SBI_PMU_FW_CTR_MAX)
+#ifdef CONFIG_SBI_PMU_MUX
+#define SBI_PMU_MUX_CTR_MAX 16
+#else
+#define SBI_PMU_MUX_CTR_MAX 0
+#endif
+#define SBI_PMU_CTR_MAX	   (SBI_PMU_HW_CTR_MAX + SBI_PMU_FW_CTR_MAX + \
+			    SBI_PMU_MUX_CTR_MAX)
 #define SBI_PMU_FIXED_CTR_MASK 0x07
 
+/* Size of the counter snapshot shared memory */
+#define SBI_PMU_SNAPSHOT_SIZE 0x1000
+
+/**
+ * OpenSBI specific firmware events which accumulate the number of
+ * M-mode cycles spent in a class of firmware activity. These use the
+ * event codes reserved for SBI implementation specific firmware events.
+ */
+enum sbi_pmu_fw_cycles_event_id {
+	SBI_PMU_FW_CYCLES_BASE		= 0x100,
+	/** Misaligned load/store emulation */
+	SBI_PMU_FW_CYCLES_MISALIGNED	= SBI_PMU_FW_CYCLES_BASE,
+	/** Illegal instruction (and CSR) emulation */
+	SBI_PMU_FW_CYCLES_ILLEGAL_INSN,
+	/** SBI ecall handling */
+	SBI_PMU_FW_CYCLES_ECALL,
+	/** IPI processing (including remote fences) */
+	SBI_PMU_FW_CYCLES_IPI,
+	/** Remote fence (TLB/fence.i) request processing */
+	SBI_PMU_FW_CYCLES_RFENCE,
+	/** Domain context switch */
+	SBI_PMU_FW_CYCLES_DOMAIN_SWITCH,
+	SBI_PMU_FW_CYCLES_MAX,
+};
+
+#define SBI_PMU_FW_CYCLES_COUNT \
+	(SBI_PMU_FW_CYCLES_MAX - SBI_PMU_FW_CYCLES_BASE)
+
+/**
+ * OpenSBI specific firmware events which count occurrences of firmware
+ * activity, in a separate range of the SBI implementation specific
+ * firmware event codes.
+ */
+enum sbi_pmu_fw_count_event_id {
+	SBI_PMU_FW_COUNT_BASE		= 0x180,
+	/** S-mode timer deadlines coalesced with a pending deadline */
+	SBI_PMU_FW_TIMER_COALESCED	= SBI_PMU_FW_COUNT_BASE,
+	/** S-mode timer interrupts injected by M-mode */
+	SBI_PMU_FW_TIMER_DELIVERED,
+	SBI_PMU_FW_COUNT_MAX,
+};
+
+#define SBI_PMU_FW_COUNT_COUNT \
+	(SBI_PMU_FW_COUNT_MAX - SBI_PMU_FW_COUNT_BASE)
+
 struct sbi_pmu_device {
 	/** Name of the PMU platform device */
 	char name[32];
@@ -106,6 +157,14 @@ void sbi_pmu_exit(struct sbi_scratch *scratch);
 /** Return the pmu irq bit depending on extension existence */
 int sbi_pmu_irq_bit(void);
 
+/**
+ * Get the bitmap of hardware counters delegated to S-mode
+ * @param scratch the HART scratch space
+ * @return bitmap of delegated counters or zero if the HART can't
+ * delegate counters (i.e. lacks Smcdeleg or Ssccfg)
+ */
+unsigned long sbi_pmu_hw_ctr_delegated_mask(struct sbi_scratch *scratch);
+
 /**
  * Add the hardware event to counter mapping information. This should be called
  * from the platform code to update the mapping table.
@@ -143,4 +202,27 @@ int sbi_pmu_ctr_cfg_match(unsigned long cidx_base, unsigned long cidx_mask,
 
 int sbi_pmu_ctr_incr_fw(enum sbi_pmu_fw_event_code_id fw_id);
 
+/**
+ * Get the start timestamp of a firmware activity for cycle accounting
+ * @return current MCYCLE value or zero if no firmware counter is started
+ */
+unsigned long sbi_pmu_fw_cycles_begin(void);
+
+/**
+ * Account M-mode cycles of a firmware activity to the started counters
+ * @param fw_id the firmware cycles event of the activity class
+ * @param start timestamp returned by sbi_pmu_fw_cycles_begin()
+ */
+void sbi_pmu_fw_cycles_end(enum sbi_pmu_fw_cycles_event_id fw_id,
+			   unsigned long start);
+
+/**
+ * Increment the started counters of an OpenSBI specific counting event
+ * @param fw_id the OpenSBI specific firmware event
+ */
+void sbi_pmu_fw_impl_incr(enum sbi_pmu_fw_count_event_id fw_id);
+
+int sbi_pmu_snapshot_set_shmem(unsigned long shmem_lo,
+			       unsigned long shmem_hi, unsigned long flags);
+
 #endif
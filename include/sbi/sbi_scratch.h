@@ -42,10 +42,24 @@
 #define SBI_SCRATCH_TMP0_OFFSET			(12 * __SIZEOF_POINTER__)
 /** Offset of options member in sbi_scratch */
 #define SBI_SCRATCH_OPTIONS_OFFSET		(13 * __SIZEOF_POINTER__)
+/** Offset of hot context in sbi_scratch */
+#define SBI_SCRATCH_HOT_OFFSET			(14 * __SIZEOF_POINTER__)
+/** Offset of hartindex member in sbi_scratch */
+#define SBI_SCRATCH_HOT_HARTINDEX_OFFSET	(14 * __SIZEOF_POINTER__)
+/** Offset of extensions member in sbi_scratch */
+#define SBI_SCRATCH_HOT_EXTENSIONS_OFFSET	(15 * __SIZEOF_POINTER__)
+/** Offset of pmu_state member in sbi_scratch */
+#define SBI_SCRATCH_HOT_PMU_STATE_OFFSET	(16 * __SIZEOF_POINTER__)
+/** Offset of timecmp_addr member in sbi_scratch */
+#define SBI_SCRATCH_HOT_TIMECMP_ADDR_OFFSET	(17 * __SIZEOF_POINTER__)
+/** Offset of msip_addr member in sbi_scratch */
+#define SBI_SCRATCH_HOT_MSIP_ADDR_OFFSET	(18 * __SIZEOF_POINTER__)
 /** Offset of extra space in sbi_scratch */
-#define SBI_SCRATCH_EXTRA_SPACE_OFFSET		(14 * __SIZEOF_POINTER__)
+#define SBI_SCRATCH_EXTRA_SPACE_OFFSET		(19 * __SIZEOF_POINTER__)
 /** Maximum size of sbi_scratch (4KB) */
 #define SBI_SCRATCH_SIZE			(0x1000)
+/** Cache line size assumed for laying out extra space in sbi_scratch */
+#define SBI_SCRATCH_CACHELINE_SIZE		(64)
 
 /* clang-format on */
 
@@ -53,6 +67,26 @@
 
 #include <sbi/sbi_types.h>
 
+/**
+ * Per-HART hot context kept at a fixed offset in sbi_scratch
+ *
+ * The fields are filled at init time so that trap and interrupt hot paths
+ * reach them with a single load relative to MSCRATCH instead of looking
+ * up the HART and its driver data.
+ */
+struct sbi_scratch_hot {
+	/** Logical index of this HART */
+	unsigned long hartindex;
+	/** Copy of the ISA extensions bitmap of this HART */
+	unsigned long extensions;
+	/** Pointer to PMU state of this HART */
+	void *pmu_state;
+	/** Address of the M-mode timer compare register (0 if none) */
+	unsigned long timecmp_addr;
+	/** Address of the M-mode software interrupt register (0 if none) */
+	unsigned long msip_addr;
+};
+
 /** Representation of per-HART scratch space */
 struct sbi_scratch {
 	/** Start (or base) address of firmware linked to OpenSBI library */
@@ -83,6 +117,8 @@ struct sbi_scratch {
 	unsigned long tmp0;
 	/** Options for OpenSBI library */
 	unsigned long options;
+	/** Hot context of this HART */
+	struct sbi_scratch_hot hot;
 };
 
 /**
@@ -144,6 +180,40 @@ _Static_assert(
 		== SBI_SCRATCH_OPTIONS_OFFSET,
 	"struct sbi_scratch definition has changed, please redefine "
 	"SBI_SCRATCH_OPTIONS_OFFSET");
+_Static_assert(
+	offsetof(struct sbi_scratch, hot)
+		== SBI_SCRATCH_HOT_OFFSET,
+	"struct sbi_scratch definition has changed, please redefine "
+	"SBI_SCRATCH_HOT_OFFSET");
+_Static_assert(
+	offsetof(struct sbi_scratch, hot.hartindex)
+		== SBI_SCRATCH_HOT_HARTINDEX_OFFSET,
+	"struct sbi_scratch definition has changed, please redefine "
+	"SBI_SCRATCH_HOT_HARTINDEX_OFFSET");
+_Static_assert(
+	offsetof(struct sbi_scratch, hot.extensions)
+		== SBI_SCRATCH_HOT_EXTENSIONS_OFFSET,
+	"struct sbi_scratch definition has changed, please redefine "
+	"SBI_SCRATCH_HOT_EXTENSIONS_OFFSET");
+_Static_assert(
+	offsetof(struct sbi_scratch, hot.pmu_state)
+		== SBI_SCRATCH_HOT_PMU_STATE_OFFSET,
+	"struct sbi_scratch definition has changed, please redefine "
+	"SBI_SCRATCH_HOT_PMU_STATE_OFFSET");
+_Static_assert(
+	offsetof(struct sbi_scratch, hot.timecmp_addr)
+		== SBI_SCRATCH_HOT_TIMECMP_ADDR_OFFSET,
+	"struct sbi_scratch definition has changed, please redefine "
+	"SBI_SCRATCH_HOT_TIMECMP_ADDR_OFFSET");
+_Static_assert(
+	offsetof(struct sbi_scratch, hot.msip_addr)
+		== SBI_SCRATCH_HOT_MSIP_ADDR_OFFSET,
+	"struct sbi_scratch definition has changed, please redefine "
+	"SBI_SCRATCH_HOT_MSIP_ADDR_OFFSET");
+_Static_assert(
+	sizeof(struct sbi_scratch) == SBI_SCRATCH_EXTRA_SPACE_OFFSET,
+	"struct sbi_scratch definition has changed, please redefine "
+	"SBI_SCRATCH_EXTRA_SPACE_OFFSET");
 
 /** Possible options for OpenSBI library */
 enum sbi_scratch_options {
@@ -157,20 +227,55 @@ enum sbi_scratch_options {
 #define sbi_scratch_thishart_ptr() \
 	((struct sbi_scratch *)csr_read(CSR_MSCRATCH))
 
+/** Get hot context of current HART */
+#define sbi_scratch_thishart_hot() \
+	(&sbi_scratch_thishart_ptr()->hot)
+
+/** Get logical index of current HART */
+#define current_hartindex() \
+	((u32)sbi_scratch_thishart_ptr()->hot.hartindex)
+
 /** Get Arg1 of next booting stage for current HART */
 #define sbi_scratch_thishart_arg1_ptr() \
 	((void *)(sbi_scratch_thishart_ptr()->next_arg1))
 
+/**
+ * Allocation classes for extra space in sbi_scratch
+ *
+ * The extra space is carved into cache lines and each cache line only
+ * holds allocations of a single class so that fields written by remote
+ * HARTs never share a cache line with fields read locally on every trap.
+ */
+enum sbi_scratch_alloc_class {
+	/** Read or written by the owner HART on hot paths */
+	SBI_SCRATCH_ALLOC_LOCAL_HOT = 0,
+	/** Written by remote HARTs (gets dedicated cache lines) */
+	SBI_SCRATCH_ALLOC_REMOTE_WRITTEN,
+	/** Rarely accessed (init-time or slow paths) */
+	SBI_SCRATCH_ALLOC_COLD,
+	SBI_SCRATCH_ALLOC_CLASS_MAX
+};
+
 /** Initialize scratch table and allocator */
 int sbi_scratch_init(struct sbi_scratch *scratch);
 
+/**
+ * Allocate from extra space in sbi_scratch for given allocation class
+ *
+ * @return zero on failure and non-zero (>= SBI_SCRATCH_EXTRA_SPACE_OFFSET)
+ * on success
+ */
+unsigned long sbi_scratch_alloc_class_offset(unsigned long size,
+					enum sbi_scratch_alloc_class aclass);
+
 /**
  * Allocate from extra space in sbi_scratch
  *
  * @return zero on failure and non-zero (>= SBI_SCRATCH_EXTRA_SPACE_OFFSET)
  * on success
  */
-unsigned long sbi_scratch_alloc_offset(unsigned long size);
+#define sbi_scratch_alloc_offset(__size)				\
+	sbi_scratch_alloc_class_offset((__size), SBI_SCRATCH_ALLOC_COLD)
 
 /** Free-up extra space in sbi_scratch */
 void sbi_scratch_free_offset(unsigned long offset);
@@ -189,6 +294,10 @@ unsigned long sbi_scratch_used_space(void);
 #define sbi_scratch_alloc_type_offset(__type)				\
 	sbi_scratch_alloc_offset(sizeof(__type))
 
+/** Allocate offset for a data type in sbi_scratch for given class */
+#define sbi_scratch_alloc_class_type_offset(__type, __aclass)		\
+	sbi_scratch_alloc_class_offset(sizeof(__type), (__aclass))
+
 /** Read a data type from sbi_scratch at given offset */
 #define sbi_scratch_read_type(__scratch, __type, __offset)		\
 ({									\
@@ -10,6 +10,7 @@
 #ifndef __SBI_TIMER_H__
 #define __SBI_TIMER_H__
 
+#include <sbi/sbi_list.h>
 #include <sbi/sbi_types.h>
 
 /** Timer hardware device */
@@ -20,6 +21,9 @@ struct sbi_timer_device {
 	/** Frequency of timer in HZ */
 	unsigned long timer_freq;
 
+	/** Address of time counter readable by S-mode (0 if none) */
+	unsigned long smode_time_addr;
+
 	/** Get free-running timer value */
 	u64 (*timer_value)(void);
 
@@ -30,6 +34,31 @@ struct sbi_timer_device {
 	void (*timer_event_stop)(void);
 };
 
+/** Firmware timer event queued on a HART */
+struct sbi_timer_event {
+	/** List head of the per-HART timer queue */
+	struct sbi_dlist head;
+	/** Absolute deadline in timer ticks */
+	u64 deadline;
+	/** Called on the HART which armed the event once it expired */
+	void (*callback)(struct sbi_timer_event *ev);
+};
+
+/** Initialize a firmware timer event */
+static inline void sbi_timer_event_init(struct sbi_timer_event *ev,
+				void (*callback)(struct sbi_timer_event *ev))
+{
+	SBI_INIT_LIST_HEAD(&ev->head);
+	ev->deadline = 0;
+	ev->callback = callback;
+}
+
+/** Check whether a firmware timer event is armed */
+static inline bool sbi_timer_event_pending(struct sbi_timer_event *ev)
+{
+	return !sbi_list_empty(&ev->head);
+}
+
 struct sbi_scratch;
 
 /** Generic delay loop of desired granularity */
@@ -87,6 +116,30 @@ void sbi_timer_event_start(u64 next_event);
 /** Process timer event for current HART */
 void sbi_timer_process(void);
 
+/**
+ * Swap the S-mode timer state of the current HART, used when switching
+ * the HART between domains.
+ *
+ * @param deadline in: S-mode deadline to program (-1ULL for none),
+ *		   out: previous S-mode deadline
+ * @param pending in: whether the S-mode timer interrupt is pending,
+ *		  out: previous pending state
+ */
+void sbi_timer_smode_swap(u64 *deadline, bool *pending);
+
+/**
+ * Arm (or re-arm) a firmware timer event on the current HART. The event
+ * must only be armed, cancelled and expire on the same HART.
+ *
+ * @param ev pointer to the timer event
+ * @param deadline absolute deadline in timer ticks
+ * @return 0 on success and negative error code on failure
+ */
+int sbi_timer_event_arm(struct sbi_timer_event *ev, u64 deadline);
+
+/** Cancel a firmware timer event armed on the current HART */
+void sbi_timer_event_cancel(struct sbi_timer_event *ev);
+
 /** Get current timer device */
 const struct sbi_timer_device *sbi_timer_get_device(void);
 
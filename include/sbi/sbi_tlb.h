@@ -28,7 +28,13 @@ struct sbi_tlb_info {
 	unsigned long asid;
 	unsigned long vmid;
 	void (*local_fn)(struct sbi_tlb_info *tinfo);
-	struct sbi_hartmask smask;
+	/*
+	 * Source HARTs waiting for this request are encoded as a single
+	 * BITS_PER_LONG wide window of HART indices starting at smask_base
+	 * so that the FIFO entry size does not grow with the HART count.
+	 */
+	u32 smask_base;
+	unsigned long smask;
 };
 
 void sbi_tlb_local_hfence_vvma(struct sbi_tlb_info *tinfo);
@@ -39,6 +45,14 @@ void sbi_tlb_local_hfence_gvma_vmid(struct sbi_tlb_info *tinfo);
 void sbi_tlb_local_sfence_vma_asid(struct sbi_tlb_info *tinfo);
 void sbi_tlb_local_fence_i(struct sbi_tlb_info *tinfo);
 
+#define SBI_TLB_INFO_SMASK_INIT(__p, __i) \
+do { \
+	u32 __si = (__i); \
+	(__p)->smask_base = __si & ~(BITS_PER_LONG - 1); \
+	(__p)->smask = (__si < SBI_HARTMASK_MAX_BITS) ? \
+		       BIT(__si & (BITS_PER_LONG - 1)) : 0; \
+} while (0)
+
 #define SBI_TLB_INFO_INIT(__p, __start, __size, __asid, __vmid, __lfn, __src) \
 do { \
 	(__p)->start = (__start); \
@@ -46,7 +60,7 @@ do { \
 	(__p)->asid = (__asid); \
 	(__p)->vmid = (__vmid); \
 	(__p)->local_fn = (__lfn); \
-	SBI_HARTMASK_INIT_EXCEPT(&(__p)->smask, (__src)); \
+	SBI_TLB_INFO_SMASK_INIT(__p, sbi_hartid_to_hartindex(__src)); \
 } while (0)
 
 #define SBI_TLB_INFO_SIZE		sizeof(struct sbi_tlb_info)
@@ -93,13 +93,28 @@ void fdt_plic_fixup(void *fdt);
  */
 int fdt_reserved_memory_fixup(void *fdt);
 
+/**
+ * Fix up the chosen node for a time counter readable by S-mode
+ *
+ * This routine adds the "opensbi,mtime" property to the chosen node with
+ * the 64 bit address of the time counter if the timer device allows S-mode
+ * to read it and the next booting stage can read it based on currently
+ * assigned domain.
+ *
+ * It is recommended that platform codes call this helper in their final_init()
+ *
+ * @param fdt: device tree blob
+ * @return zero on success and -ve on failure
+ */
+int fdt_timer_fixup(void *fdt);
+
 /**
  * General device tree fix-up
  *
  * This routine do all required device tree fix-ups for a typical platform.
- * It fixes up the PLIC node, IMSIC nodes, APLIC nodes, and the reserved
- * memory node in the device tree by calling the corresponding helper
- * routines to accomplish the task.
+ * It fixes up the PLIC node, IMSIC nodes, APLIC nodes, the reserved
+ * memory node, and the chosen node in the device tree by calling the
+ * corresponding helper routines to accomplish the task.
  *
  * It is recommended that platform codes call this helper in their final_init()
  *
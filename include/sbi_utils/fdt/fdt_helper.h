@@ -32,6 +32,9 @@ struct platform_uart_data {
 	unsigned long reg_shift;
 	unsigned long reg_io_width;
 	unsigned long reg_offset;
+	unsigned long fifo_size;
+	unsigned long irq;
+	unsigned long irq_parent_addr;
 };
 
 const struct fdt_match *fdt_match_node(void *fdt, int nodeoff,
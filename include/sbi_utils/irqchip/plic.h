@@ -29,6 +29,14 @@ void plic_context_save(const struct plic_data *plic, int context_id,
 void plic_context_restore(const struct plic_data *plic, int context_id,
 			  const u32 *enable, u32 threshold, u32 num);
 
+int plic_context_route_irq(const struct plic_data *plic, int context_id,
+			   u32 hwirq, bool enable);
+
+u32 plic_context_claim(const struct plic_data *plic, int context_id);
+
+void plic_context_complete(const struct plic_data *plic, int context_id,
+			   u32 hwirq);
+
 int plic_context_init(const struct plic_data *plic, int context_id,
 		      bool enable, u32 threshold);
 
@@ -13,4 +13,7 @@
 
 int cadence_uart_init(unsigned long base, u32 in_freq, u32 baudrate);
 
+/** Override the default TX FIFO depth */
+void cadence_uart_set_fifo_size(u32 fifo_size);
+
 #endif
@@ -15,4 +15,13 @@
 int uart8250_init(unsigned long base, u32 in_freq, u32 baudrate, u32 reg_shift,
 		  u32 reg_width, u32 reg_offset);
 
+/** Override the probed TX FIFO depth (zero keeps the probed depth) */
+void uart8250_set_fifo_size(u32 fifo_size);
+
+/**
+ * Buffer input from the receive interrupt wired to the given hwirq of
+ * the interrupt controller at parent_addr
+ */
+int uart8250_set_rx_hwirq(u32 hwirq, unsigned long parent_addr);
+
 #endif
@@ -350,6 +350,49 @@ int pmp_set(unsigned int n, unsigned long prot, unsigned long addr,
 	return 0;
 }
 
+int pmp_set_tor(unsigned int n, unsigned long prot, unsigned long addr,
+		unsigned long size)
+{
+	int pmpcfg_csr, pmpcfg_shift, pmpaddr_csr;
+	unsigned long cfgmask, pmpcfg;
+
+	/* check parameters */
+	if (n >= PMP_COUNT || !size || (addr + size) < addr ||
+	    (!n && addr))
+		return SBI_EINVAL;
+
+	/* calculate PMP register and offset */
+#if __riscv_xlen == 32
+	pmpcfg_csr   = CSR_PMPCFG0 + (n >> 2);
+	pmpcfg_shift = (n & 3) << 3;
+#elif __riscv_xlen == 64
+	pmpcfg_csr   = (CSR_PMPCFG0 + (n >> 2)) & ~1;
+	pmpcfg_shift = (n & 7) << 3;
+#else
+# error "Unexpected __riscv_xlen"
+#endif
+	pmpaddr_csr = CSR_PMPADDR0 + n;
+
+	/* encode PMP config */
+	prot &= ~PMP_A;
+	prot |= PMP_A_TOR;
+	cfgmask = ~(0xffUL << pmpcfg_shift);
+	pmpcfg	= (csr_read_num(pmpcfg_csr) & cfgmask);
+	pmpcfg |= ((prot << pmpcfg_shift) & ~cfgmask);
+
+	/*
+	 * The bottom of a TOR range comes from the previous pmpaddr CSR
+	 * so write it first. The previous entry must either be disabled
+	 * or already end at the same address.
+	 */
+	if (n)
+		csr_write_num(pmpaddr_csr - 1, addr >> PMP_SHIFT);
+	csr_write_num(pmpaddr_csr, (addr + size) >> PMP_SHIFT);
+	csr_write_num(pmpcfg_csr, pmpcfg);
+
+	return 0;
+}
+
 int pmp_get(unsigned int n, unsigned long *prot_out, unsigned long *addr_out,
 	    unsigned long *log2len)
 {
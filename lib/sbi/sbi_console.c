@@ -7,12 +7,18 @@
  *   Anup Patel <anup.patel@wdc.com>
  */
 
+#include <sbi/riscv_atomic.h>
+#include <sbi/riscv_barrier.h>
 #include <sbi/riscv_locks.h>
 #include <sbi/sbi_console.h>
+#include <sbi/sbi_error.h>
 #include <sbi/sbi_hart.h>
+#include <sbi/sbi_heap.h>
+#include <sbi/sbi_irqchip.h>
 #include <sbi/sbi_platform.h>
 #include <sbi/sbi_scratch.h>
 #include <sbi/sbi_string.h>
+#include <sbi/sbi_timer.h>
 
 #define CONSOLE_TBUF_MAX 256
 
@@ -21,6 +27,260 @@ static char console_tbuf[CONSOLE_TBUF_MAX];
 static u32 console_tbuf_len;
 static spinlock_t console_out_lock	       = SPIN_LOCK_INITIALIZER;
 
+static unsigned long nputs(const char *str, unsigned long len);
+static void nputs_all(const char *str, unsigned long len);
+
+#ifdef CONFIG_SBI_CONSOLE_BINLOG
+static void console_binlog_drain_all(void);
+#else
+#define console_binlog_drain_all()	do { } while (0)
+#endif
+
+#ifdef CONFIG_SBI_CONSOLE_ASYNC
+#define CONSOLE_RING_SIZE	(1U << CONFIG_SBI_CONSOLE_RING_SHIFT)
+#define CONSOLE_RING_MASK	(CONSOLE_RING_SIZE - 1)
+
+/**
+ * Per-HART console log ring
+ *
+ * Only the owner HART writes wpos and head whereas only the HART holding
+ * console_out_lock writes tail. Bytes between head and wpos belong to a
+ * message still being formatted and are not drained yet.
+ */
+struct console_ring {
+	/** Position of the next byte written by the owner HART */
+	u32 wpos;
+	/** End of bytes published to the drainer */
+	volatile u32 head;
+	/** Start of bytes not yet written to the console device */
+	volatile u32 tail;
+	/** Ring buffer */
+	char buf[CONSOLE_RING_SIZE];
+};
+
+static struct console_ring **console_rings;
+static u32 console_ring_count;
+static volatile unsigned long console_drain_pending;
+
+static struct console_ring *console_thishart_ring(void)
+{
+	u32 hartindex = current_hartindex();
+
+	if (hartindex < console_ring_count)
+		return console_rings[hartindex];
+	return NULL;
+}
+
+/* Write out the published bytes of a ring with console_out_lock held */
+static void console_ring_drain(struct console_ring *ring)
+{
+	u32 head = ring->head, tail = ring->tail, off, len;
+
+	/* Read published bytes only after reading head */
+	smp_rmb();
+
+	while (tail != head) {
+		off = tail & CONSOLE_RING_MASK;
+		len = head - tail;
+		if (len > CONSOLE_RING_SIZE - off)
+			len = CONSOLE_RING_SIZE - off;
+		nputs_all(&ring->buf[off], len);
+		tail += len;
+	}
+
+	/* Owner may reuse the space only after the bytes were read */
+	smp_mb();
+	ring->tail = tail;
+}
+
+static void console_drain_all(void)
+{
+	u32 i;
+
+	for (i = 0; i < console_ring_count; i++) {
+		if (console_rings[i])
+			console_ring_drain(console_rings[i]);
+	}
+
+	console_binlog_drain_all();
+}
+
+/*
+ * Drain the rings of all HARTs unless another HART is already draining.
+ * A HART failing to get console_out_lock leaves console_drain_pending set
+ * so that the HART holding the lock makes another pass before leaving.
+ */
+static void console_drain(void)
+{
+	atomic_raw_xchg_ulong(&console_drain_pending, 1);
+
+	while (console_drain_pending) {
+		if (!spin_trylock(&console_out_lock))
+			return;
+		atomic_raw_xchg_ulong(&console_drain_pending, 0);
+		console_drain_all();
+		spin_unlock(&console_out_lock);
+	}
+}
+
+static void console_ring_publish(struct console_ring *ring)
+{
+	/* Make the bytes visible before publishing them */
+	smp_wmb();
+	ring->head = ring->wpos;
+}
+
+static void console_ring_putc(char ch)
+{
+	struct console_ring *ring = console_thishart_ring();
+
+	/*
+	 * Wait for the drainer when the ring is full. A message which
+	 * doesn't fit in the ring on its own is published in pieces.
+	 */
+	while ((ring->wpos - ring->tail) >= CONSOLE_RING_SIZE) {
+		if (ring->head == ring->tail)
+			console_ring_publish(ring);
+		console_drain();
+	}
+
+	ring->buf[ring->wpos & CONSOLE_RING_MASK] = ch;
+	ring->wpos++;
+}
+
+static int console_rings_init(void)
+{
+	u32 i, count = sbi_scratch_last_hartindex() + 1;
+
+	console_rings = sbi_calloc(sizeof(*console_rings), count);
+	if (!console_rings)
+		return SBI_ENOMEM;
+
+	/* HARTs without a ring keep printing synchronously */
+	for (i = 0; i < count; i++)
+		console_rings[i] = sbi_zalloc(sizeof(struct console_ring));
+
+	/* Publish the rings only after they are set up */
+	smp_wmb();
+	console_ring_count = count;
+
+	return 0;
+}
+#else
+#define console_thishart_ring()		NULL
+#define console_ring_publish(__ring)	do { } while (0)
+#define console_ring_putc(__ch)		do { } while (0)
+#define console_drain()			do { } while (0)
+#define console_drain_all()		console_binlog_drain_all()
+#define console_rings_init()		0
+#endif
+
+void sbi_console_flush(void)
+{
+	spin_lock(&console_out_lock);
+	console_drain_all();
+	spin_unlock(&console_out_lock);
+}
+
+#ifdef CONFIG_SBI_CONSOLE_RX_IRQ
+#define CONSOLE_RX_RING_SIZE	256
+#define CONSOLE_RX_RING_MASK	(CONSOLE_RX_RING_SIZE - 1)
+
+static char console_rx_buf[CONSOLE_RX_RING_SIZE];
+static u32 console_rx_head;
+static u32 console_rx_tail;
+static spinlock_t console_rx_lock = SPIN_LOCK_INITIALIZER;
+
+/*
+ * Move everything the device has received into the RX ring. All device
+ * reads go through here under the RX lock so the byte order is kept no
+ * matter whether the interrupt handler or a reader drains the device.
+ * Input which doesn't fit is dropped so that the device FIFO always
+ * gets emptied and a level triggered interrupt goes away.
+ */
+static void console_rx_fill(void)
+{
+	int ch;
+
+	while ((ch = console_dev->console_getc()) >= 0) {
+		if (console_rx_head - console_rx_tail >= CONSOLE_RX_RING_SIZE)
+			continue;
+		console_rx_buf[console_rx_head & CONSOLE_RX_RING_MASK] = ch;
+		console_rx_head++;
+	}
+}
+
+static unsigned long console_rx_read(char *str, unsigned long len)
+{
+	unsigned long i = 0;
+
+	spin_lock(&console_rx_lock);
+	console_rx_fill();
+	while (i < len && console_rx_tail != console_rx_head) {
+		str[i++] = console_rx_buf[console_rx_tail & CONSOLE_RX_RING_MASK];
+		console_rx_tail++;
+	}
+	spin_unlock(&console_rx_lock);
+
+	return i;
+}
+
+static int console_rx_irq(u32 hwirq, void *priv)
+{
+	spin_lock(&console_rx_lock);
+	console_rx_fill();
+	spin_unlock(&console_rx_lock);
+
+	return 0;
+}
+
+static void (*console_rx_enable)(void);
+
+static void console_rx_routed(u32 hwirq, void *priv)
+{
+	console_rx_enable();
+}
+
+int sbi_console_set_rx_hwirq(u32 hwirq, unsigned long parent_addr,
+			     void (*rx_enable)(void))
+{
+	int rc;
+
+	if (!rx_enable)
+		return SBI_EINVAL;
+
+	rc = sbi_irqchip_register_hwirq_handler(hwirq, parent_addr,
+						console_rx_irq,
+						console_rx_routed, NULL);
+	if (rc)
+		return rc;
+
+	console_rx_enable = rx_enable;
+	return 0;
+}
+#else
+static unsigned long console_rx_read(char *str, unsigned long len)
+{
+	unsigned long i;
+	int ch;
+
+	for (i = 0; i < len; i++) {
+		ch = console_dev->console_getc();
+		if (ch < 0)
+			break;
+		str[i] = ch;
+	}
+
+	return i;
+}
+
+int sbi_console_set_rx_hwirq(u32 hwirq, unsigned long parent_addr,
+			     void (*rx_enable)(void))
+{
+	return SBI_ENOTSUPP;
+}
+#endif
+
 bool sbi_isprintable(char c)
 {
 	if (((31 < c) && (c < 127)) || (c == '\f') || (c == '\r') ||
@@ -32,8 +292,11 @@ bool sbi_isprintable(char c)
 
 int sbi_getc(void)
 {
-	if (console_dev && console_dev->console_getc)
-		return console_dev->console_getc();
+	char ch;
+
+	if (console_dev && console_dev->console_getc &&
+	    console_rx_read(&ch, 1))
+		return (unsigned char)ch;
 	return -1;
 }
 
@@ -46,6 +309,31 @@ void sbi_putc(char ch)
 	}
 }
 
+unsigned long sbi_console_puts_fifo(const char *str, unsigned long len,
+				    u32 fifo_size, void (*wait_empty)(void),
+				    void (*write)(char ch))
+{
+	unsigned long i;
+	u32 room = fifo_size;
+
+	wait_empty();
+
+	for (i = 0; i < len; i++) {
+		if (str[i] == '\n') {
+			if (room < 2)
+				break;
+			write('\r');
+			room--;
+		} else if (!room) {
+			break;
+		}
+		write(str[i]);
+		room--;
+	}
+
+	return i;
+}
+
 static unsigned long nputs(const char *str, unsigned long len)
 {
 	unsigned long i, ret;
@@ -74,6 +362,7 @@ void sbi_puts(const char *str)
 	unsigned long len = sbi_strlen(str);
 
 	spin_lock(&console_out_lock);
+	console_drain_all();
 	nputs_all(str, len);
 	spin_unlock(&console_out_lock);
 }
@@ -83,6 +372,7 @@ unsigned long sbi_nputs(const char *str, unsigned long len)
 	unsigned long ret;
 
 	spin_lock(&console_out_lock);
+	console_drain_all();
 	ret = nputs(str, len);
 	spin_unlock(&console_out_lock);
 
@@ -104,17 +394,10 @@ void sbi_gets(char *s, int maxwidth, char endchar)
 
 unsigned long sbi_ngets(char *str, unsigned long len)
 {
-	int ch;
-	unsigned long i;
-
-	for (i = 0; i < len; i++) {
-		ch = sbi_getc();
-		if (ch < 0)
-			break;
-		str[i] = ch;
-	}
+	if (!console_dev || !console_dev->console_getc)
+		return 0;
 
-	return i;
+	return console_rx_read(str, len);
 }
 
 #define PAD_RIGHT 1
@@ -122,15 +405,58 @@ unsigned long sbi_ngets(char *str, unsigned long len)
 #define PAD_ALTERNATE 4
 #define PAD_SIGN 8
 #define USE_TBUF 16
+#define USE_RING 32
 #define PRINT_BUF_LEN 64
 
 #define va_start(v, l) __builtin_va_start((v), l)
 #define va_end __builtin_va_end
 #define va_arg __builtin_va_arg
+#define va_copy __builtin_va_copy
 typedef __builtin_va_list va_list;
 
+/*
+ * Arguments of print() come either from a va_list or, when rendering
+ * a binary log record, from an array of raw argument words.
+ */
+struct print_args {
+	const unsigned long *words;
+	u32 nwords;
+	va_list ap;
+};
+
+static unsigned long print_arg_word(struct print_args *pa)
+{
+	if (!pa->nwords)
+		return 0;
+	pa->nwords--;
+	return *pa->words++;
+}
+
+static unsigned long long print_arg_dword(struct print_args *pa)
+{
+	unsigned long long val;
+
+	if (!pa->words)
+		return va_arg(pa->ap, unsigned long long);
+
+	val = print_arg_word(pa);
+	if (sizeof(unsigned long) < sizeof(val))
+		val |= (unsigned long long)print_arg_word(pa) << 32;
+
+	return val;
+}
+
+#define print_arg(__pa, __type)						\
+	((__pa)->words ? (__type)print_arg_word(__pa) :			\
+			 va_arg((__pa)->ap, __type))
+
 static void printc(char **out, u32 *out_len, char ch, int flags)
 {
+	if (flags & USE_RING) {
+		console_ring_putc(ch);
+		return;
+	}
+
 	if (!out) {
 		sbi_putc(ch);
 		return;
@@ -252,17 +578,22 @@ static int printi(char **out, u32 *out_len, long long i,
 	return pc + prints(out, out_len, s, width, flags);
 }
 
-static int print(char **out, u32 *out_len, const char *format, va_list args)
+static int __print(char **out, u32 *out_len, const char *format,
+		   struct print_args *args)
 {
 	bool flags_done;
 	int width, flags, pc = 0;
 	char type, scr[2], *tout;
-	bool use_tbuf = (!out) ? true : false;
+	bool use_ring = (!out && !args->words && console_thishart_ring()) ?
+			true : false;
+	bool use_tbuf = (!out && !use_ring) ? true : false;
 
 	/*
 	 * The console_tbuf is protected by console_out_lock and
 	 * print() is always called with console_out_lock held
-	 * when out == NULL.
+	 * when out == NULL and the HART has no console ring.
+	 * Binary log records are always rendered with the lock
+	 * held.
 	 */
 	if (use_tbuf) {
 		console_tbuf_len = CONSOLE_TBUF_MAX;
@@ -281,6 +612,8 @@ static int print(char **out, u32 *out_len, const char *format, va_list args)
 		width = flags = 0;
 		if (use_tbuf)
 			flags |= USE_TBUF;
+		if (use_ring)
+			flags |= USE_RING;
 		if (*format == '%') {
 			++format;
 			if (*format == '\0')
@@ -322,24 +655,24 @@ static int print(char **out, u32 *out_len, const char *format, va_list args)
 				width += *format - '0';
 			}
 			if (*format == 's') {
-				char *s = va_arg(args, char *);
+				char *s = print_arg(args, char *);
 				pc += prints(out, out_len, s ? s : "(null)",
 					     width, flags);
 				continue;
 			}
 			if ((*format == 'd') || (*format == 'i')) {
-				pc += printi(out, out_len, va_arg(args, int),
+				pc += printi(out, out_len, print_arg(args, int),
 					     width, flags, *format);
 				continue;
 			}
 			if ((*format == 'u') || (*format == 'o')
 					 || (*format == 'x') || (*format == 'X')) {
-				pc += printi(out, out_len, va_arg(args, unsigned int),
+				pc += printi(out, out_len, print_arg(args, unsigned int),
 					     width, flags, *format);
 				continue;
 			}
 			if ((*format == 'p') || (*format == 'P')) {
-				pc += printi(out, out_len, (uintptr_t)va_arg(args, void*),
+				pc += printi(out, out_len, (uintptr_t)print_arg(args, void*),
 					     width, flags, *format);
 				continue;
 			}
@@ -353,7 +686,7 @@ static int print(char **out, u32 *out_len, const char *format, va_list args)
 						++format;
 						type = *format;
 					}
-					pc += printi(out, out_len, va_arg(args, long long),
+					pc += printi(out, out_len, (long long)print_arg_dword(args),
 						width, flags, type);
 					continue;
 				}
@@ -364,16 +697,16 @@ static int print(char **out, u32 *out_len, const char *format, va_list args)
 					type = *format;
 				}
 				if ((type == 'd') || (type == 'i'))
-					pc += printi(out, out_len, va_arg(args, long),
+					pc += printi(out, out_len, print_arg(args, long),
 					     width, flags, type);
 				else
-					pc += printi(out, out_len, va_arg(args, unsigned long),
+					pc += printi(out, out_len, print_arg(args, unsigned long),
 					     width, flags, type);
 				continue;
 			}
 			if (*format == 'c') {
 				/* char are converted to int then pushed on the stack */
-				scr[0] = va_arg(args, int);
+				scr[0] = print_arg(args, int);
 				scr[1] = '\0';
 				pc += prints(out, out_len, scr, width, flags);
 				continue;
@@ -391,6 +724,18 @@ literal:
 	return pc;
 }
 
+static int print(char **out, u32 *out_len, const char *format, va_list args)
+{
+	struct print_args pa = { .words = NULL };
+	int retval;
+
+	va_copy(pa.ap, args);
+	retval = __print(out, out_len, format, &pa);
+	va_end(pa.ap);
+
+	return retval;
+}
+
 int sbi_sprintf(char *out, const char *format, ...)
 {
 	va_list args;
@@ -422,16 +767,264 @@ int sbi_snprintf(char *out, u32 out_sz, const char *format, ...)
 	return retval;
 }
 
+#ifdef CONFIG_SBI_CONSOLE_BINLOG
+#define CONSOLE_BINLOG_SIZE	(1U << CONFIG_SBI_CONSOLE_BINLOG_SHIFT)
+#define CONSOLE_BINLOG_MASK	(CONSOLE_BINLOG_SIZE - 1)
+#define CONSOLE_BINLOG_MAX_WORDS	16
+
+/**
+ * Per-HART binary log
+ *
+ * Each record is a format string pointer, the number of argument words
+ * and the argument words themselves. Only the owner HART writes head
+ * and dropped whereas only the HART holding console_out_lock writes
+ * tail and dropped_seen. The drain event is only touched by the owner.
+ */
+struct console_binlog {
+	/** End of published words */
+	volatile u32 head;
+	/** Start of words not yet rendered */
+	volatile u32 tail;
+	/** Number of records which didn't fit */
+	volatile u32 dropped;
+	/** Number of dropped records already reported */
+	u32 dropped_seen;
+	/** Owner HART timer event bounding how long records stay deferred */
+	struct sbi_timer_event drain_ev;
+	/** Word ring */
+	unsigned long words[CONSOLE_BINLOG_SIZE];
+};
+
+static struct console_binlog **console_binlogs;
+static u32 console_binlog_count;
+
+static struct console_binlog *console_thishart_binlog(void)
+{
+	u32 hartindex = current_hartindex();
+
+	if (hartindex < console_binlog_count)
+		return console_binlogs[hartindex];
+	return NULL;
+}
+
+/* Fetch the arguments the way print() consumes them */
+static u32 console_binlog_args(const char *format, va_list args,
+			       unsigned long *words)
+{
+	unsigned long long val;
+	u32 n = 0;
+
+	for (; *format && n < CONSOLE_BINLOG_MAX_WORDS - 1; ++format) {
+		if (*format != '%')
+			continue;
+		++format;
+		while (*format && sbi_strchr("-+#0 '", *format))
+			++format;
+		while (*format >= '0' && *format <= '9')
+			++format;
+
+		switch (*format) {
+		case '\0':
+			return n;
+		case 's':
+		case 'p':
+		case 'P':
+			words[n++] = (unsigned long)va_arg(args, void *);
+			break;
+		case 'd':
+		case 'i':
+		case 'u':
+		case 'o':
+		case 'x':
+		case 'X':
+		case 'c':
+			words[n++] = va_arg(args, int);
+			break;
+		case 'l':
+			if (format[1] == 'l') {
+				++format;
+				if (format[1] && sbi_strchr("uodixX", format[1]))
+					++format;
+				val = va_arg(args, unsigned long long);
+				words[n++] = val;
+				if (sizeof(unsigned long) < sizeof(val))
+					words[n++] = val >> 32;
+				break;
+			}
+			if (format[1] && sbi_strchr("uodixX", format[1]))
+				++format;
+			words[n++] = va_arg(args, unsigned long);
+			break;
+		default:
+			break;
+		}
+	}
+
+	return n;
+}
+
+static void console_binlog_drain_event(struct sbi_timer_event *ev)
+{
+	sbi_console_flush();
+}
+
+/*
+ * Make sure the records of this HART get written out within the drain
+ * period even if no HART prints or flushes the console meanwhile. On a
+ * HART without a timer event queue the records wait for the next print.
+ */
+static void console_binlog_arm_drain(struct console_binlog *log)
+{
+	const struct sbi_timer_device *tdev;
+
+	if (!CONFIG_SBI_CONSOLE_BINLOG_DRAIN_MS ||
+	    sbi_timer_event_pending(&log->drain_ev))
+		return;
+
+	tdev = sbi_timer_get_device();
+	if (!tdev)
+		return;
+
+	sbi_timer_event_arm(&log->drain_ev, sbi_timer_value() +
+			    (u64)tdev->timer_freq *
+			    CONFIG_SBI_CONSOLE_BINLOG_DRAIN_MS / 1000);
+}
+
+/* Record a debug print without formatting it */
+static bool console_binlog_record(const char *format, va_list args)
+{
+	struct console_binlog *log = console_thishart_binlog();
+	unsigned long rec[2 + CONSOLE_BINLOG_MAX_WORDS];
+	u32 i, len, head;
+
+	if (!log)
+		return false;
+
+	rec[0] = (unsigned long)format;
+	rec[1] = console_binlog_args(format, args, &rec[2]);
+	len = 2 + rec[1];
+
+	head = log->head;
+	if (CONSOLE_BINLOG_SIZE - (head - log->tail) < len) {
+		log->dropped++;
+		return true;
+	}
+
+	for (i = 0; i < len; i++)
+		log->words[(head + i) & CONSOLE_BINLOG_MASK] = rec[i];
+
+	/* Make the record visible before publishing it */
+	smp_wmb();
+	log->head = head + len;
+
+	console_binlog_arm_drain(log);
+
+	return true;
+}
+
+/* Render the published records of a log with console_out_lock held */
+static void console_binlog_drain(struct console_binlog *log)
+{
+	unsigned long rec[2 + CONSOLE_BINLOG_MAX_WORDS];
+	u32 i, len, head = log->head, tail = log->tail, dropped;
+	struct print_args pa;
+
+	/* Read published words only after reading head */
+	smp_rmb();
+
+	while (tail != head) {
+		rec[0] = log->words[tail & CONSOLE_BINLOG_MASK];
+		rec[1] = log->words[(tail + 1) & CONSOLE_BINLOG_MASK];
+		len = 2 + rec[1];
+		for (i = 2; i < len; i++)
+			rec[i] = log->words[(tail + i) & CONSOLE_BINLOG_MASK];
+		tail += len;
+
+		pa.words = &rec[2];
+		pa.nwords = rec[1];
+		__print(NULL, NULL, (const char *)rec[0], &pa);
+	}
+
+	/* Owner may reuse the space only after the words were read */
+	smp_mb();
+	log->tail = tail;
+
+	dropped = log->dropped;
+	if (dropped != log->dropped_seen) {
+		pa.words = &rec[0];
+		pa.nwords = 1;
+		rec[0] = dropped - log->dropped_seen;
+		__print(NULL, NULL, "binlog: %u debug prints dropped\n", &pa);
+		log->dropped_seen = dropped;
+	}
+}
+
+static void console_binlog_drain_all(void)
+{
+	u32 i;
+
+	for (i = 0; i < console_binlog_count; i++) {
+		if (console_binlogs[i])
+			console_binlog_drain(console_binlogs[i]);
+	}
+}
+
+static int console_binlogs_init(void)
+{
+	u32 i, count = sbi_scratch_last_hartindex() + 1;
+
+	console_binlogs = sbi_calloc(sizeof(*console_binlogs), count);
+	if (!console_binlogs)
+		return SBI_ENOMEM;
+
+	/* HARTs without a log keep formatting debug prints in place */
+	for (i = 0; i < count; i++) {
+		console_binlogs[i] = sbi_zalloc(sizeof(struct console_binlog));
+		if (console_binlogs[i])
+			sbi_timer_event_init(&console_binlogs[i]->drain_ev,
+					     console_binlog_drain_event);
+	}
+
+	/* Publish the logs only after they are set up */
+	smp_wmb();
+	console_binlog_count = count;
+
+	return 0;
+}
+#else
+#define console_binlog_record(__format, __args)	false
+#define console_binlogs_init()			0
+#endif
+
+static int console_vprintf(const char *format, va_list args)
+{
+	struct console_ring *ring = console_thishart_ring();
+	int retval;
+
+	/* Format into the ring of this HART and drain if nobody else is */
+	if (ring) {
+		retval = print(NULL, NULL, format, args);
+		console_ring_publish(ring);
+		console_drain();
+		return retval;
+	}
+
+	spin_lock(&console_out_lock);
+	console_binlog_drain_all();
+	retval = print(NULL, NULL, format, args);
+	spin_unlock(&console_out_lock);
+
+	return retval;
+}
+
 int sbi_printf(const char *format, ...)
 {
 	va_list args;
 	int retval;
 
-	spin_lock(&console_out_lock);
 	va_start(args, format);
-	retval = print(NULL, NULL, format, args);
+	retval = console_vprintf(format, args);
 	va_end(args);
-	spin_unlock(&console_out_lock);
 
 	return retval;
 }
@@ -443,11 +1036,9 @@ int sbi_dprintf(const char *format, ...)
 	struct sbi_scratch *scratch = sbi_scratch_thishart_ptr();
 
 	va_start(args, format);
-	if (scratch->options & SBI_SCRATCH_DEBUG_PRINTS) {
-		spin_lock(&console_out_lock);
-		retval = print(NULL, NULL, format, args);
-		spin_unlock(&console_out_lock);
-	}
+	if ((scratch->options & SBI_SCRATCH_DEBUG_PRINTS) &&
+	    !console_binlog_record(format, args))
+		retval = console_vprintf(format, args);
 	va_end(args);
 
 	return retval;
@@ -457,11 +1048,9 @@ void sbi_panic(const char *format, ...)
 {
 	va_list args;
 
-	spin_lock(&console_out_lock);
 	va_start(args, format);
-	print(NULL, NULL, format, args);
+	console_vprintf(format, args);
 	va_end(args);
-	spin_unlock(&console_out_lock);
 
 	sbi_hart_hang();
 }
@@ -486,6 +1075,12 @@ int sbi_console_init(struct sbi_scratch *scratch)
 	/* console is not a necessary device */
 	if (rc == SBI_ENODEV)
 		return 0;
+	if (rc)
+		return rc;
+
+	rc = console_rings_init();
+	if (rc)
+		return rc;
 
-	return rc;
+	return console_binlogs_init();
 }
@@ -40,6 +40,9 @@ struct sbi_domain root = {
 
 static unsigned long domain_hart_ptr_offset;
 
+/* Offset of pointer to last address interval found by current HART */
+static unsigned long domain_addr_cache_offset;
+
 struct sbi_domain *sbi_hartindex_to_domain(u32 hartindex)
 {
 	struct sbi_scratch *scratch;
@@ -51,7 +54,7 @@ struct sbi_domain *sbi_hartindex_to_domain(u32 hartindex)
 	return sbi_scratch_read_type(scratch, void *, domain_hart_ptr_offset);
 }
 
-static void update_hartindex_to_domain(u32 hartindex, struct sbi_domain *dom)
+void sbi_update_hartindex_to_domain(u32 hartindex, struct sbi_domain *dom)
 {
 	struct sbi_scratch *scratch;
 
@@ -111,16 +114,11 @@ void sbi_domain_memregion_init(unsigned long addr,
 	}
 }
 
-bool sbi_domain_check_addr(const struct sbi_domain *dom,
-			   unsigned long addr, unsigned long mode,
-			   unsigned long access_flags)
+static bool is_access_allowed(unsigned long rflags, unsigned long mode,
+			      unsigned long access_flags)
 {
 	bool rmmio, mmio = false;
-	struct sbi_domain_memregion *reg;
-	unsigned long rstart, rend, rflags, rwx = 0, rrwx = 0;
-
-	if (!dom)
-		return false;
+	unsigned long rwx = 0, rrwx;
 
 	/*
 	 * Use M_{R/W/X} bits because the SU-bits are at the
@@ -139,22 +137,94 @@ bool sbi_domain_check_addr(const struct sbi_domain *dom,
 	if (access_flags & SBI_DOMAIN_MMIO)
 		mmio = true;
 
-	sbi_domain_for_each_memregion(dom, reg) {
-		rflags = reg->flags;
-		rrwx = (mode == PRV_M ?
-			(rflags & SBI_DOMAIN_MEMREGION_M_ACCESS_MASK) :
-			(rflags & SBI_DOMAIN_MEMREGION_SU_ACCESS_MASK)
-			>> SBI_DOMAIN_MEMREGION_SU_ACCESS_SHIFT);
+	rrwx = (mode == PRV_M ?
+		(rflags & SBI_DOMAIN_MEMREGION_M_ACCESS_MASK) :
+		(rflags & SBI_DOMAIN_MEMREGION_SU_ACCESS_MASK)
+		>> SBI_DOMAIN_MEMREGION_SU_ACCESS_SHIFT);
+
+	rmmio = (rflags & SBI_DOMAIN_MEMREGION_MMIO) ? true : false;
+	if (mmio != rmmio)
+		return false;
+
+	return ((rrwx & rwx) == rwx) ? true : false;
+}
+
+static const struct sbi_domain_memregion *find_region(
+						const struct sbi_domain *dom,
+						unsigned long addr)
+{
+	unsigned long rstart, rend;
+	struct sbi_domain_memregion *reg;
 
+	sbi_domain_for_each_memregion(dom, reg) {
 		rstart = reg->base;
 		rend = (reg->order < __riscv_xlen) ?
 			rstart + ((1UL << reg->order) - 1) : -1UL;
-		if (rstart <= addr && addr <= rend) {
-			rmmio = (rflags & SBI_DOMAIN_MEMREGION_MMIO) ? true : false;
-			if (mmio != rmmio)
-				return false;
-			return ((rrwx & rwx) == rwx) ? true : false;
-		}
+		if (rstart <= addr && addr <= rend)
+			return reg;
+	}
+
+	return NULL;
+}
+
+static const struct sbi_domain_addr_interval *find_interval(
+						const struct sbi_domain *dom,
+						unsigned long addr)
+{
+	const struct sbi_domain_addr_interval *iv, **cache = NULL;
+	u32 lo = 0, hi = dom->interval_count, mid;
+
+	/* Try the interval found last time on this HART first */
+	if (domain_addr_cache_offset) {
+		cache = sbi_scratch_thishart_offset_ptr(
+						domain_addr_cache_offset);
+		iv = *cache;
+		if (iv && dom->intervals <= iv &&
+		    iv < &dom->intervals[dom->interval_count] &&
+		    iv->start <= addr && addr <= iv->end)
+			return iv;
+	}
+
+	/* Find the last interval starting at or below the address */
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		if (dom->intervals[mid].start <= addr)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	if (!lo)
+		return NULL;
+
+	iv = &dom->intervals[lo - 1];
+	if (addr > iv->end)
+		return NULL;
+
+	if (cache)
+		*cache = iv;
+
+	return iv;
+}
+
+bool sbi_domain_check_addr(const struct sbi_domain *dom,
+			   unsigned long addr, unsigned long mode,
+			   unsigned long access_flags)
+{
+	const struct sbi_domain_addr_interval *iv;
+	const struct sbi_domain_memregion *reg;
+
+	if (!dom)
+		return false;
+
+	if (dom->intervals) {
+		iv = find_interval(dom, addr);
+		if (iv)
+			return is_access_allowed(iv->flags, mode, access_flags);
+	} else {
+		reg = find_region(dom, addr);
+		if (reg)
+			return is_access_allowed(reg->flags, mode,
+						 access_flags);
 	}
 
 	return (mode == PRV_M) ? true : false;
@@ -218,24 +288,6 @@ static bool is_region_before(const struct sbi_domain_memregion *regA,
 	return false;
 }
 
-static const struct sbi_domain_memregion *find_region(
-						const struct sbi_domain *dom,
-						unsigned long addr)
-{
-	unsigned long rstart, rend;
-	struct sbi_domain_memregion *reg;
-
-	sbi_domain_for_each_memregion(dom, reg) {
-		rstart = reg->base;
-		rend = (reg->order < __riscv_xlen) ?
-			rstart + ((1UL << reg->order) - 1) : -1UL;
-		if (rstart <= addr && addr <= rend)
-			return reg;
-	}
-
-	return NULL;
-}
-
 static const struct sbi_domain_memregion *find_next_subset_region(
 				const struct sbi_domain *dom,
 				const struct sbi_domain_memregion *reg,
@@ -256,6 +308,83 @@ static const struct sbi_domain_memregion *find_next_subset_region(
 	return ret;
 }
 
+static void add_interval_point(unsigned long *points, u32 *count,
+			       unsigned long addr)
+{
+	u32 i, j;
+
+	for (i = 0; i < *count && points[i] < addr; i++)
+		;
+	if (i < *count && points[i] == addr)
+		return;
+
+	for (j = *count; j > i; j--)
+		points[j] = points[j - 1];
+	points[i] = addr;
+	(*count)++;
+}
+
+/**
+ * Flatten the memory regions of a domain into non-overlapping address
+ * intervals carrying the flags of the region which is effective for
+ * the interval. Adjacent intervals with same flags are merged.
+ */
+static int build_domain_intervals(struct sbi_domain *dom)
+{
+	u32 i, count = 0, npoints = 0, niv = 0;
+	const struct sbi_domain_memregion *reg;
+	struct sbi_domain_memregion *r;
+	struct sbi_domain_addr_interval *ivs;
+	unsigned long *points, end;
+
+	sbi_domain_for_each_memregion(dom, r)
+		count++;
+
+	points = sbi_calloc(sizeof(*points), 2 * count);
+	if (!points)
+		return SBI_ENOMEM;
+
+	/* The effective region can only change at region boundaries */
+	sbi_domain_for_each_memregion(dom, r) {
+		add_interval_point(points, &npoints, r->base);
+		if (r->order < __riscv_xlen) {
+			end = r->base + BIT(r->order);
+			if (end)
+				add_interval_point(points, &npoints, end);
+		}
+	}
+
+	ivs = sbi_calloc(sizeof(*ivs), npoints);
+	if (!ivs) {
+		sbi_free(points);
+		return SBI_ENOMEM;
+	}
+
+	for (i = 0; i < npoints; i++) {
+		reg = find_region(dom, points[i]);
+		if (!reg)
+			continue;
+
+		end = (i + 1 < npoints) ? points[i + 1] - 1 : -1UL;
+		if (niv && ivs[niv - 1].end + 1 == points[i] &&
+		    ivs[niv - 1].flags == reg->flags) {
+			ivs[niv - 1].end = end;
+			continue;
+		}
+
+		ivs[niv].start = points[i];
+		ivs[niv].end = end;
+		ivs[niv].flags = reg->flags;
+		niv++;
+	}
+
+	sbi_free(points);
+	dom->intervals = ivs;
+	dom->interval_count = niv;
+
+	return 0;
+}
+
 static int sanitize_domain(const struct sbi_platform *plat,
 			   struct sbi_domain *dom)
 {
@@ -367,10 +496,31 @@ bool sbi_domain_check_addr_range(const struct sbi_domain *dom,
 {
 	unsigned long max = addr + size;
 	const struct sbi_domain_memregion *reg, *sreg;
+	const struct sbi_domain_addr_interval *iv, *iv_end;
 
 	if (!dom)
 		return false;
 
+	if (dom->intervals) {
+		iv = find_interval(dom, addr);
+		iv_end = &dom->intervals[dom->interval_count];
+		while (addr < max) {
+			/* Addresses not covered by any region are denied */
+			if (!iv || iv == iv_end || addr < iv->start)
+				return false;
+
+			if (!is_access_allowed(iv->flags, mode, access_flags))
+				return false;
+
+			if (iv->end == -1UL)
+				break;
+			addr = iv->end + 1;
+			iv++;
+		}
+
+		return true;
+	}
+
 	while (addr < max) {
 		reg = find_region(dom, addr);
 		if (!reg)
@@ -474,6 +624,14 @@ void sbi_domain_dump(const struct sbi_domain *dom, const char *suffix)
 
 	sbi_printf("Domain%d SysSuspend  %s: %s\n",
 		   dom->index, suffix, (dom->system_suspend_allowed) ? "yes" : "no");
+
+	if (dom->timer_slack_us)
+		sbi_printf("Domain%d TimerSlack  %s: %u us\n",
+			   dom->index, suffix, dom->timer_slack_us);
+
+	if (dom->enter_domains)
+		sbi_printf("Domain%d EnterMask   %s: 0x%08x\n",
+			   dom->index, suffix, dom->enter_domains);
 }
 
 void sbi_domain_dump_all(const char *suffix)
@@ -541,7 +699,7 @@ int sbi_domain_register(struct sbi_domain *dom,
 		if (tdom)
 			sbi_hartmask_clear_hartindex(i,
 					&tdom->assigned_harts);
-		update_hartindex_to_domain(i, dom);
+		sbi_update_hartindex_to_domain(i, dom);
 		sbi_hartmask_set_hartindex(i, &dom->assigned_harts);
 
 		/*
@@ -666,6 +824,17 @@ int sbi_domain_finalize(struct sbi_scratch *scratch, u32 cold_hartid)
 		return rc;
 	}
 
+	/* Flatten memory regions of domains for fast address checks */
+	sbi_domain_for_each(i, dom) {
+		rc = build_domain_intervals(dom);
+		if (rc) {
+			sbi_printf("%s: failed to build address intervals"
+				   " for %s (error %d)\n", __func__,
+				   dom->name, rc);
+			return rc;
+		}
+	}
+
 	/* Startup boot HART of domains */
 	sbi_domain_for_each(i, dom) {
 		/* Domain boot HART index */
@@ -734,15 +903,23 @@ int sbi_domain_init(struct sbi_scratch *scratch, u32 cold_hartid)
 		return SBI_EINVAL;
 	}
 
-	domain_hart_ptr_offset = sbi_scratch_alloc_type_offset(void *);
+	domain_hart_ptr_offset = sbi_scratch_alloc_class_type_offset(void *,
+					SBI_SCRATCH_ALLOC_LOCAL_HOT);
 	if (!domain_hart_ptr_offset)
 		return SBI_ENOMEM;
 
+	domain_addr_cache_offset = sbi_scratch_alloc_class_type_offset(void *,
+					SBI_SCRATCH_ALLOC_LOCAL_HOT);
+	if (!domain_addr_cache_offset) {
+		rc = SBI_ENOMEM;
+		goto fail_free_domain_hart_ptr_offset;
+	}
+
 	root_memregs = sbi_calloc(sizeof(*root_memregs), ROOT_REGION_MAX + 1);
 	if (!root_memregs) {
 		sbi_printf("%s: no memory for root regions\n", __func__);
 		rc = SBI_ENOMEM;
-		goto fail_free_domain_hart_ptr_offset;
+		goto fail_free_domain_addr_cache_offset;
 	}
 	root.regions = root_memregs;
 
@@ -808,6 +985,9 @@ fail_free_root_hmask:
 	sbi_free(root_hmask);
 fail_free_root_memregs:
 	sbi_free(root_memregs);
+fail_free_domain_addr_cache_offset:
+	sbi_scratch_free_offset(domain_addr_cache_offset);
+	domain_addr_cache_offset = 0;
 fail_free_domain_hart_ptr_offset:
 	sbi_scratch_free_offset(domain_hart_ptr_offset);
 	return rc;
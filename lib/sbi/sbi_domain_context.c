@@ -0,0 +1,264 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * Copyright (c) 2026 The OpenSBI Authors.
+ *
+ * Authors:
+ *   agent <agent@local>
+ */
+
+#include <sbi/riscv_asm.h>
+#include <sbi/riscv_atomic.h>
+#include <sbi/sbi_console.h>
+#include <sbi/sbi_domain.h>
+#include <sbi/sbi_domain_context.h>
+#include <sbi/sbi_error.h>
+#include <sbi/sbi_hart.h>
+#include <sbi/sbi_hartmask.h>
+#include <sbi/sbi_heap.h>
+#include <sbi/sbi_hfence.h>
+#include <sbi/sbi_pmu.h>
+#include <sbi/sbi_scratch.h>
+#include <sbi/sbi_string.h>
+#include <sbi/sbi_timer.h>
+
+/* Per-HART pointer to the context requested by the current SBI call */
+static unsigned long domain_ctx_next_offset;
+
+/*
+ * The context tables are allocated at init time and each HART only
+ * fills its own slot, so no locking is needed here.
+ */
+static struct sbi_context *domain_context_get(struct sbi_domain *dom,
+					      u32 hartindex, bool alloc)
+{
+	struct sbi_context *ctx;
+
+	if (!dom->hartindex_to_context_table)
+		return NULL;
+
+	ctx = dom->hartindex_to_context_table[hartindex];
+	if (!ctx && alloc) {
+		ctx = sbi_zalloc(sizeof(*ctx));
+		if (!ctx)
+			return NULL;
+		ctx->dom = dom;
+		dom->hartindex_to_context_table[hartindex] = ctx;
+	}
+
+	return ctx;
+}
+
+static int domain_context_request(struct sbi_context *next)
+{
+	if (!domain_ctx_next_offset)
+		return SBI_ENOTSUPP;
+
+	sbi_scratch_write_type(sbi_scratch_thishart_ptr(), struct sbi_context *,
+			       domain_ctx_next_offset, next);
+	return 0;
+}
+
+static void domain_context_setup(struct sbi_context *ctx,
+				 const struct sbi_trap_regs *regs)
+{
+	struct sbi_domain *dom = ctx->dom;
+	unsigned long mstatus;
+
+	/* Start the next booting stage of the domain like a cold boot */
+	sbi_memset(&ctx->regs, 0, sizeof(ctx->regs));
+	ctx->regs.a0 = current_hartid();
+	ctx->regs.a1 = dom->next_arg1;
+	ctx->regs.mepc = dom->next_addr;
+
+	/*
+	 * Nothing of the S-mode state of the caller leaks into the new
+	 * domain, the FPU and vector state are enabled as on cold boot.
+	 */
+	mstatus = regs->mstatus & ~(MSTATUS_MPP | MSTATUS_MPIE |
+				    MSTATUS_SIE | MSTATUS_SPIE | MSTATUS_SPP |
+				    MSTATUS_SUM | MSTATUS_MXR |
+				    MSTATUS_FS | MSTATUS_VS);
+	if (misa_extension('D') || misa_extension('F'))
+		mstatus |= MSTATUS_FS;
+	if (misa_extension('V'))
+		mstatus |= MSTATUS_VS;
+	mstatus |= dom->next_mode << MSTATUS_MPP_SHIFT;
+#if __riscv_xlen == 32
+	ctx->regs.mstatusH = regs->mstatusH & ~MSTATUSH_MPV;
+#else
+	mstatus &= ~MSTATUS_MPV;
+#endif
+	ctx->regs.mstatus = mstatus;
+
+	ctx->sie = 0;
+	ctx->stvec = dom->next_addr;
+	ctx->sscratch = 0;
+	ctx->satp = 0;
+	ctx->timer_deadline = -1ULL;
+	ctx->timer_pending = false;
+	ctx->initialized = true;
+}
+
+static void switch_to_next_domain_context(struct sbi_scratch *scratch,
+					  struct sbi_trap_regs *regs,
+					  struct sbi_context *dom_ctx)
+{
+	unsigned long cycles = sbi_pmu_fw_cycles_begin();
+	u32 hartindex = current_hartindex();
+	struct sbi_domain *dom = sbi_domain_thishart_ptr();
+	struct sbi_domain *target_dom = dom_ctx->dom;
+	struct sbi_context *ctx = domain_context_get(dom, hartindex, false);
+
+	/*
+	 * Assign current HART to target domain. Other HARTs may switch
+	 * domains at the same time so update the masks atomically.
+	 */
+	atomic_raw_clear_bit(hartindex, dom->assigned_harts.bits);
+	sbi_update_hartindex_to_domain(hartindex, target_dom);
+	atomic_raw_set_bit(hartindex, target_dom->assigned_harts.bits);
+
+	/* Only rewrite the PMP entries which differ between the domains */
+	sbi_hart_pmp_switch(scratch);
+
+	if (!dom_ctx->initialized)
+		domain_context_setup(dom_ctx, regs);
+
+	/*
+	 * Save current CSR context and restore target domain's CSR context.
+	 * The sstatus bits are part of the mstatus saved in the trap state.
+	 */
+	ctx->sie = csr_swap(CSR_SIE, dom_ctx->sie);
+	ctx->stvec = csr_swap(CSR_STVEC, dom_ctx->stvec);
+	ctx->sscratch = csr_swap(CSR_SSCRATCH, dom_ctx->sscratch);
+	ctx->sepc = csr_swap(CSR_SEPC, dom_ctx->sepc);
+	ctx->scause = csr_swap(CSR_SCAUSE, dom_ctx->scause);
+	ctx->stval = csr_swap(CSR_STVAL, dom_ctx->stval);
+	ctx->sip = csr_swap(CSR_SIP, dom_ctx->sip);
+	ctx->satp = csr_swap(CSR_SATP, dom_ctx->satp);
+	ctx->scounteren = csr_swap(CSR_SCOUNTEREN, dom_ctx->scounteren);
+	if (sbi_hart_priv_version(scratch) >= SBI_HART_PRIV_VER_1_12)
+		ctx->senvcfg = csr_swap(CSR_SENVCFG, dom_ctx->senvcfg);
+
+	/* The S-mode timer of each domain must only fire into that domain */
+	ctx->timer_deadline = dom_ctx->timer_deadline;
+	ctx->timer_pending = dom_ctx->timer_pending;
+	sbi_timer_smode_swap(&ctx->timer_deadline, &ctx->timer_pending);
+
+	/*
+	 * Save the trap state of the completed SBI call so that the
+	 * current domain resumes after it, and restore the trap state
+	 * of the target domain.
+	 */
+	sbi_memcpy(&ctx->regs, regs, sizeof(*regs));
+	sbi_memcpy(regs, &dom_ctx->regs, sizeof(*regs));
+	ctx->initialized = true;
+
+	/*
+	 * The S-mode address translation context changed so translations
+	 * cached for the previous domain must not be used anymore. This
+	 * also covers the PMP entries changed above.
+	 */
+	__asm__ __volatile__("sfence.vma");
+	if (misa_extension('H'))
+		__sbi_hfence_gvma_all();
+
+	sbi_pmu_fw_cycles_end(SBI_PMU_FW_CYCLES_DOMAIN_SWITCH, cycles);
+}
+
+int sbi_domain_context_enter(struct sbi_domain *dom)
+{
+	u32 hartindex = current_hartindex();
+	struct sbi_domain *cur = sbi_domain_thishart_ptr();
+	struct sbi_context *ctx, *dom_ctx, *pctx;
+	int rc;
+
+	if (!dom || dom == cur || !dom->possible_harts ||
+	    !sbi_hartmask_test_hartindex(hartindex, dom->possible_harts))
+		return SBI_EINVAL;
+
+	/* Only domains explicitly allowed by the platform can be entered */
+	if (!(cur->enter_domains & (1U << dom->index)))
+		return SBI_EDENIED;
+
+	ctx = domain_context_get(cur, hartindex, true);
+	dom_ctx = domain_context_get(dom, hartindex, true);
+	if (!ctx || !dom_ctx)
+		return SBI_ENOMEM;
+
+	/* A domain can't be entered again before it has exited */
+	for (pctx = ctx; pctx; pctx = pctx->prev_ctx) {
+		if (pctx->dom == dom)
+			return SBI_EDENIED;
+	}
+
+	rc = domain_context_request(dom_ctx);
+	if (rc)
+		return rc;
+
+	dom_ctx->prev_ctx = ctx;
+	return 0;
+}
+
+int sbi_domain_context_exit(void)
+{
+	u32 hartindex = current_hartindex();
+	struct sbi_context *ctx;
+	int rc;
+
+	ctx = domain_context_get(sbi_domain_thishart_ptr(), hartindex, false);
+	if (!ctx || !ctx->prev_ctx)
+		return SBI_EDENIED;
+
+	rc = domain_context_request(ctx->prev_ctx);
+	if (rc)
+		return rc;
+
+	ctx->prev_ctx = NULL;
+	return 0;
+}
+
+void sbi_domain_context_process(struct sbi_trap_regs *regs)
+{
+	struct sbi_scratch *scratch;
+	struct sbi_context *next;
+
+	if (likely(!domain_ctx_next_offset))
+		return;
+
+	scratch = sbi_scratch_thishart_ptr();
+	next = sbi_scratch_read_type(scratch, struct sbi_context *,
+				     domain_ctx_next_offset);
+	if (likely(!next))
+		return;
+
+	sbi_scratch_write_type(scratch, struct sbi_context *,
+			       domain_ctx_next_offset, NULL);
+	switch_to_next_domain_context(scratch, regs, next);
+}
+
+int sbi_domain_context_init(void)
+{
+	struct sbi_domain *dom;
+	u32 i;
+
+	if (domain_ctx_next_offset)
+		return 0;
+
+	/* All domains are registered by now */
+	sbi_domain_for_each(i, dom) {
+		dom->hartindex_to_context_table = sbi_calloc(
+			SBI_HARTMASK_MAX_BITS,
+			sizeof(*dom->hartindex_to_context_table));
+		if (!dom->hartindex_to_context_table)
+			return SBI_ENOMEM;
+	}
+
+	domain_ctx_next_offset = sbi_scratch_alloc_class_type_offset(
+					struct sbi_context *,
+					SBI_SCRATCH_ALLOC_LOCAL_HOT);
+	if (!domain_ctx_next_offset)
+		return SBI_ENOMEM;
+
+	return 0;
+}
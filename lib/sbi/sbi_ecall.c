@@ -8,6 +8,7 @@
  */
 
 #include <sbi/sbi_console.h>
+#include <sbi/sbi_domain_context.h>
 #include <sbi/sbi_ecall.h>
 #include <sbi/sbi_ecall_interface.h>
 #include <sbi/sbi_error.h>
@@ -141,6 +142,9 @@ int sbi_ecall_handler(struct sbi_trap_regs *regs)
 		regs->a0 = ret;
 		if (!is_0_1_spec)
 			regs->a1 = out_val;
+
+		/* Switch domain context if requested by this call */
+		sbi_domain_context_process(regs);
 	}
 
 	return 0;
@@ -0,0 +1,54 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * Copyright (c) 2026 The OpenSBI Authors.
+ *
+ * Authors:
+ *   agent <agent@local>
+ */
+
+#include <sbi/sbi_domain.h>
+#include <sbi/sbi_domain_context.h>
+#include <sbi/sbi_ecall.h>
+#include <sbi/sbi_ecall_interface.h>
+#include <sbi/sbi_error.h>
+#include <sbi/sbi_trap.h>
+
+static int sbi_ecall_domain_handler(unsigned long extid, unsigned long funcid,
+				    const struct sbi_trap_regs *regs,
+				    unsigned long *out_val,
+				    struct sbi_trap_info *out_trap)
+{
+	switch (funcid) {
+	case SBI_EXT_OPENSBI_DOMAIN_ENTER:
+		if (SBI_DOMAIN_MAX_INDEX <= regs->a0)
+			return SBI_EINVAL;
+		return sbi_domain_context_enter(sbi_index_to_domain(regs->a0));
+	case SBI_EXT_OPENSBI_DOMAIN_EXIT:
+		return sbi_domain_context_exit();
+	default:
+		break;
+	}
+
+	return SBI_ENOTSUPP;
+}
+
+struct sbi_ecall_extension ecall_domain;
+
+static int sbi_ecall_domain_register_extensions(void)
+{
+	int rc;
+
+	rc = sbi_domain_context_init();
+	if (rc)
+		return rc;
+
+	return sbi_ecall_register_extension(&ecall_domain);
+}
+
+struct sbi_ecall_extension ecall_domain = {
+	.extid_start		= SBI_EXT_OPENSBI,
+	.extid_end		= SBI_EXT_OPENSBI,
+	.register_extensions	= sbi_ecall_domain_register_extensions,
+	.handle			= sbi_ecall_domain_handler,
+};
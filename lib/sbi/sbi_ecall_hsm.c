@@ -22,6 +22,7 @@ static int sbi_ecall_hsm_handler(unsigned long extid, unsigned long funcid,
 				 struct sbi_trap_info *out_trap)
 {
 	int ret = 0;
+	ulong exp_sleep = 0;
 	struct sbi_scratch *scratch = sbi_scratch_thishart_ptr();
 	ulong smode = (csr_read(CSR_MSTATUS) & MSTATUS_MPP) >>
 			MSTATUS_MPP_SHIFT;
@@ -39,8 +40,13 @@ static int sbi_ecall_hsm_handler(unsigned long extid, unsigned long funcid,
 					     regs->a0);
 		break;
 	case SBI_EXT_HSM_HART_SUSPEND:
+#ifdef CONFIG_SBI_HSM_IDLE_GOVERNOR
+		/* Only governed suspend takes the expected sleep duration */
+		if (regs->a0 == SBI_HSM_SUSPEND_GOVERNED)
+			exp_sleep = regs->a3;
+#endif
 		ret = sbi_hsm_hart_suspend(scratch, regs->a0, regs->a1,
-					   smode, regs->a2);
+					   smode, regs->a2, exp_sleep);
 		break;
 	default:
 		ret = SBI_ENOTSUPP;
@@ -11,12 +11,15 @@
 #include <sbi/riscv_barrier.h>
 #include <sbi/riscv_encoding.h>
 #include <sbi/riscv_fp.h>
+#include <sbi/riscv_locks.h>
 #include <sbi/sbi_bitops.h>
 #include <sbi/sbi_console.h>
 #include <sbi/sbi_domain.h>
 #include <sbi/sbi_csr_detect.h>
 #include <sbi/sbi_error.h>
 #include <sbi/sbi_hart.h>
+#include <sbi/sbi_heap.h>
+#include <sbi/sbi_list.h>
 #include <sbi/sbi_math.h>
 #include <sbi/sbi_platform.h>
 #include <sbi/sbi_pmu.h>
@@ -31,59 +34,45 @@ void (*sbi_hart_expected_trap)(void) = &__sbi_expected_trap;
 
 static unsigned long hart_features_offset;
 
-static void mstatus_init(struct sbi_scratch *scratch)
+/**
+ * M-mode CSR values programmed whenever a HART starts
+ *
+ * The values only depend on the features of the HART so they are built
+ * on the first start and simply written again on later starts and on
+ * non-retentive resume. The image is rebuilt when the HART extensions
+ * changed since it was built.
+ */
+struct hart_boot_csrs {
+	bool valid;
+	bool smode;
+	unsigned long extensions;
+	unsigned long mstatus;
+	unsigned long mideleg;
+	unsigned long medeleg;
+	u64 mstateen0;
+	u64 menvcfg;
+};
+
+static unsigned long hart_boot_csrs_offset;
+
+static void hart_boot_csrs_build(struct sbi_scratch *scratch,
+				 struct hart_boot_csrs *bc)
 {
-	unsigned long menvcfg_val, mstatus_val = 0;
-	int cidx;
-	unsigned int mhpm_mask = sbi_hart_mhpm_mask(scratch);
-	uint64_t mhpmevent_init_val = 0;
-	uint64_t mstateen_val;
+	const struct sbi_platform *plat = sbi_platform_ptr(scratch);
+	u64 mstateen_val, menvcfg_val;
+
+	bc->smode = misa_extension('S');
+	bc->extensions = scratch->hot.extensions;
+
+	bc->mstatus = 0;
 
 	/* Enable FPU */
 	if (misa_extension('D') || misa_extension('F'))
-		mstatus_val |=  MSTATUS_FS;
+		bc->mstatus |=  MSTATUS_FS;
 
 	/* Enable Vector context */
 	if (misa_extension('V'))
-		mstatus_val |=  MSTATUS_VS;
-
-	csr_write(CSR_MSTATUS, mstatus_val);
-
-	/* Disable user mode usage of all perf counters except default ones (CY, TM, IR) */
-	if (misa_extension('S') &&
-	    sbi_hart_priv_version(scratch) >= SBI_HART_PRIV_VER_1_10)
-		csr_write(CSR_SCOUNTEREN, 7);
-
-	/**
-	 * OpenSBI doesn't use any PMU counters in M-mode.
-	 * Supervisor mode usage for all counters are enabled by default
-	 * But counters will not run until mcountinhibit is set.
-	 */
-	if (sbi_hart_priv_version(scratch) >= SBI_HART_PRIV_VER_1_10)
-		csr_write(CSR_MCOUNTEREN, -1);
-
-	/* All programmable counters will start running at runtime after S-mode request */
-	if (sbi_hart_priv_version(scratch) >= SBI_HART_PRIV_VER_1_11)
-		csr_write(CSR_MCOUNTINHIBIT, 0xFFFFFFF8);
-
-	/**
-	 * The mhpmeventn[h] CSR should be initialized with interrupt disabled
-	 * and inhibited running in M-mode during init.
-	 */
-	mhpmevent_init_val |= (MHPMEVENT_OF | MHPMEVENT_MINH);
-	for (cidx = 0; cidx <= 28; cidx++) {
-		if (!(mhpm_mask & 1 << (cidx + 3)))
-			continue;
-#if __riscv_xlen == 32
-		csr_write_num(CSR_MHPMEVENT3 + cidx,
-			       mhpmevent_init_val & 0xFFFFFFFF);
-		if (sbi_hart_has_extension(scratch, SBI_HART_EXT_SSCOFPMF))
-			csr_write_num(CSR_MHPMEVENT3H + cidx,
-				      mhpmevent_init_val >> BITS_PER_LONG);
-#else
-		csr_write_num(CSR_MHPMEVENT3 + cidx, mhpmevent_init_val);
-#endif
-	}
+		bc->mstatus |=  MSTATUS_VS;
 
 	if (sbi_hart_has_extension(scratch, SBI_HART_EXT_SMSTATEEN)) {
 		mstateen_val = csr_read(CSR_MSTATEEN0);
@@ -100,14 +89,14 @@ static void mstatus_init(struct sbi_scratch *scratch)
 		else
 			mstateen_val &= ~(SMSTATEEN0_AIA | SMSTATEEN0_SVSLCT |
 					SMSTATEEN0_IMSIC);
-		csr_write(CSR_MSTATEEN0, mstateen_val);
-#if __riscv_xlen == 32
-		csr_write(CSR_MSTATEEN0H, mstateen_val >> 32);
-#endif
+		bc->mstateen0 = mstateen_val;
 	}
 
 	if (sbi_hart_priv_version(scratch) >= SBI_HART_PRIV_VER_1_12) {
 		menvcfg_val = csr_read(CSR_MENVCFG);
+#if __riscv_xlen == 32
+		menvcfg_val |= ((uint64_t)csr_read(CSR_MENVCFGH)) << 32;
+#endif
 
 		/*
 		 * Set menvcfg.CBZE == 1
@@ -150,23 +139,125 @@ static void mstatus_init(struct sbi_scratch *scratch)
 		 */
 		if (sbi_hart_has_extension(scratch, SBI_HART_EXT_SSTC)) {
 #if __riscv_xlen == 32
-			unsigned long menvcfgh_val;
-			menvcfgh_val = csr_read(CSR_MENVCFGH);
-			menvcfgh_val |= ENVCFGH_STCE;
-			csr_write(CSR_MENVCFGH, menvcfgh_val);
+			menvcfg_val |= ((uint64_t)ENVCFGH_STCE) << 32;
 #else
 			menvcfg_val |= ENVCFG_STCE;
 #endif
 		}
 
-		csr_write(CSR_MENVCFG, menvcfg_val);
+		/*
+		 * Delegate the counters enabled in mcounteren to S-mode
+		 * via indirect CSR access when Smcdeleg and Ssccfg are
+		 * present so that S-mode can program them directly.
+		 */
+		if (sbi_pmu_hw_ctr_delegated_mask(scratch)) {
+#if __riscv_xlen == 32
+			menvcfg_val |= ((uint64_t)ENVCFGH_CDE) << 32;
+#else
+			menvcfg_val |= ENVCFG_CDE;
+#endif
+		}
+
+		bc->menvcfg = menvcfg_val;
+	}
+
+	if (bc->smode) {
+		/* Send M-mode interrupts and most exceptions to S-mode */
+		bc->mideleg = MIP_SSIP | MIP_STIP | MIP_SEIP;
+		bc->mideleg |= sbi_pmu_irq_bit();
+
+		bc->medeleg = (1U << CAUSE_MISALIGNED_FETCH) |
+			      (1U << CAUSE_BREAKPOINT) |
+			      (1U << CAUSE_USER_ECALL);
+		if (sbi_platform_has_mfaults_delegation(plat))
+			bc->medeleg |= (1U << CAUSE_FETCH_PAGE_FAULT) |
+				       (1U << CAUSE_LOAD_PAGE_FAULT) |
+				       (1U << CAUSE_STORE_PAGE_FAULT);
+
+		/*
+		 * If hypervisor extension available then we only handle
+		 * hypervisor calls (i.e. ecalls from HS-mode) in M-mode.
+		 *
+		 * The HS-mode will additionally handle supervisor calls
+		 * (i.e. ecalls from VS-mode), Guest page faults and Virtual
+		 * interrupts.
+		 */
+		if (misa_extension('H')) {
+			bc->medeleg |= (1U << CAUSE_VIRTUAL_SUPERVISOR_ECALL);
+			bc->medeleg |= (1U << CAUSE_FETCH_GUEST_PAGE_FAULT);
+			bc->medeleg |= (1U << CAUSE_LOAD_GUEST_PAGE_FAULT);
+			bc->medeleg |= (1U << CAUSE_VIRTUAL_INST_FAULT);
+			bc->medeleg |= (1U << CAUSE_STORE_GUEST_PAGE_FAULT);
+		}
+	}
+
+	bc->valid = true;
+}
+
+static void mstatus_init(struct sbi_scratch *scratch,
+			 const struct hart_boot_csrs *bc)
+{
+	int cidx;
+	unsigned int mhpm_mask = sbi_hart_mhpm_mask(scratch);
+	uint64_t mhpmevent_init_val = 0;
+
+	csr_write(CSR_MSTATUS, bc->mstatus);
+
+	/* Disable user mode usage of all perf counters except default ones (CY, TM, IR) */
+	if (bc->smode &&
+	    sbi_hart_priv_version(scratch) >= SBI_HART_PRIV_VER_1_10)
+		csr_write(CSR_SCOUNTEREN, 7);
+
+	/**
+	 * OpenSBI doesn't use any PMU counters in M-mode.
+	 * Supervisor mode usage for all counters are enabled by default
+	 * But counters will not run until mcountinhibit is set.
+	 */
+	if (sbi_hart_priv_version(scratch) >= SBI_HART_PRIV_VER_1_10)
+		csr_write(CSR_MCOUNTEREN, -1);
+
+	/* All programmable counters will start running at runtime after S-mode request */
+	if (sbi_hart_priv_version(scratch) >= SBI_HART_PRIV_VER_1_11)
+		csr_write(CSR_MCOUNTINHIBIT, 0xFFFFFFF8);
+
+	/**
+	 * The mhpmeventn[h] CSR should be initialized with interrupt disabled
+	 * and inhibited running in M-mode during init.
+	 */
+	mhpmevent_init_val |= (MHPMEVENT_OF | MHPMEVENT_MINH);
+	for (cidx = 0; cidx <= 28; cidx++) {
+		if (!(mhpm_mask & 1 << (cidx + 3)))
+			continue;
+#if __riscv_xlen == 32
+		csr_write_num(CSR_MHPMEVENT3 + cidx,
+			       mhpmevent_init_val & 0xFFFFFFFF);
+		if (sbi_hart_has_extension(scratch, SBI_HART_EXT_SSCOFPMF))
+			csr_write_num(CSR_MHPMEVENT3H + cidx,
+				      mhpmevent_init_val >> BITS_PER_LONG);
+#else
+		csr_write_num(CSR_MHPMEVENT3 + cidx, mhpmevent_init_val);
+#endif
+	}
+
+	if (sbi_hart_has_extension(scratch, SBI_HART_EXT_SMSTATEEN)) {
+		csr_write(CSR_MSTATEEN0, bc->mstateen0);
+#if __riscv_xlen == 32
+		csr_write(CSR_MSTATEEN0H, bc->mstateen0 >> 32);
+#endif
+	}
+
+	if (sbi_hart_priv_version(scratch) >= SBI_HART_PRIV_VER_1_12) {
+#if __riscv_xlen == 32
+		csr_write(CSR_MENVCFGH, bc->menvcfg >> 32);
+#endif
+		csr_write(CSR_MENVCFG, bc->menvcfg);
 	}
 
 	/* Disable all interrupts */
 	csr_write(CSR_MIE, 0);
 
 	/* Disable S-mode paging */
-	if (misa_extension('S'))
+	if (bc->smode)
 		csr_write(CSR_SATP, 0);
 }
 
@@ -191,43 +282,14 @@ static int fp_init(struct sbi_scratch *scratch)
 	return 0;
 }
 
-static int delegate_traps(struct sbi_scratch *scratch)
+static int delegate_traps(const struct hart_boot_csrs *bc)
 {
-	const struct sbi_platform *plat = sbi_platform_ptr(scratch);
-	unsigned long interrupts, exceptions;
-
-	if (!misa_extension('S'))
+	if (!bc->smode)
 		/* No delegation possible as mideleg does not exist */
 		return 0;
 
-	/* Send M-mode interrupts and most exceptions to S-mode */
-	interrupts = MIP_SSIP | MIP_STIP | MIP_SEIP;
-	interrupts |= sbi_pmu_irq_bit();
-
-	exceptions = (1U << CAUSE_MISALIGNED_FETCH) | (1U << CAUSE_BREAKPOINT) |
-		     (1U << CAUSE_USER_ECALL);
-	if (sbi_platform_has_mfaults_delegation(plat))
-		exceptions |= (1U << CAUSE_FETCH_PAGE_FAULT) |
-			      (1U << CAUSE_LOAD_PAGE_FAULT) |
-			      (1U << CAUSE_STORE_PAGE_FAULT);
-
-	/*
-	 * If hypervisor extension available then we only handle hypervisor
-	 * calls (i.e. ecalls from HS-mode) in M-mode.
-	 *
-	 * The HS-mode will additionally handle supervisor calls (i.e. ecalls
-	 * from VS-mode), Guest page faults and Virtual interrupts.
-	 */
-	if (misa_extension('H')) {
-		exceptions |= (1U << CAUSE_VIRTUAL_SUPERVISOR_ECALL);
-		exceptions |= (1U << CAUSE_FETCH_GUEST_PAGE_FAULT);
-		exceptions |= (1U << CAUSE_LOAD_GUEST_PAGE_FAULT);
-		exceptions |= (1U << CAUSE_VIRTUAL_INST_FAULT);
-		exceptions |= (1U << CAUSE_STORE_GUEST_PAGE_FAULT);
-	}
-
-	csr_write(CSR_MIDELEG, interrupts);
-	csr_write(CSR_MEDELEG, exceptions);
+	csr_write(CSR_MIDELEG, bc->mideleg);
+	csr_write(CSR_MEDELEG, bc->medeleg);
 
 	return 0;
 }
@@ -368,6 +430,665 @@ static void sbi_hart_smepmp_set(struct sbi_scratch *scratch,
 	}
 }
 
+static unsigned int sbi_hart_get_oldpmp_flags(struct sbi_domain_memregion *reg)
+{
+	unsigned int pmp_flags = 0;
+
+	/*
+	 * If permissions are to be enforced for all modes on
+	 * this region, the lock bit should be set.
+	 */
+	if (reg->flags & SBI_DOMAIN_MEMREGION_ENF_PERMISSIONS)
+		pmp_flags |= PMP_L;
+
+	if (reg->flags & SBI_DOMAIN_MEMREGION_SU_READABLE)
+		pmp_flags |= PMP_R;
+	if (reg->flags & SBI_DOMAIN_MEMREGION_SU_WRITABLE)
+		pmp_flags |= PMP_W;
+	if (reg->flags & SBI_DOMAIN_MEMREGION_SU_EXECUTABLE)
+		pmp_flags |= PMP_X;
+
+	return pmp_flags;
+}
+
+/** One PMP entry computed by the PMP planner */
+struct hart_pmp_entry {
+	/** Lowest address covered by the entry */
+	unsigned long base;
+	/** Highest address covered by the entry (inclusive) */
+	unsigned long end;
+	/** NAPOT order of the entry (unused for TOR entries) */
+	unsigned long order;
+	/** PMP permission and lock bits */
+	unsigned int flags;
+	/** Entry must be programmed before setting MSECCFG.MML */
+	bool m_only;
+	/** Entry is a TOR range instead of a NAPOT region */
+	bool tor;
+	/** TOR entry needs the previous PMP entry as its bottom bound */
+	bool lo_slot;
+	/** PMP entry index assigned to this entry */
+	unsigned int idx;
+};
+
+/** PMP layout of a domain as programmed on a HART */
+struct hart_pmp_plan {
+	/** Domain for which the plan was computed */
+	const struct sbi_domain *dom;
+	/** Number of domain memory regions when the plan was computed */
+	unsigned int nregions;
+	/** Number of planned entries */
+	unsigned int count;
+	/** Number of PMP entries needed by the plan */
+	unsigned int slots;
+	/** Number of PMP entries saved compared to one entry per region */
+	unsigned int saved;
+	/** Planned entries in priority order */
+	struct hart_pmp_entry ents[];
+};
+
+/** Per-HART cache of PMP plans indexed by domain index */
+struct hart_pmp_plan_cache {
+	/** Plan currently programmed in the PMP (NULL if unknown) */
+	struct hart_pmp_plan *active;
+	/** Computed plans */
+	struct hart_pmp_plan *plans[SBI_DOMAIN_MAX_INDEX];
+};
+
+static unsigned long hart_pmp_plan_offset;
+
+#define HART_PMP_NO_MATCH	(~0U)
+
+static unsigned int hart_pmp_entry_attr(const struct hart_pmp_entry *e)
+{
+	return e->flags | (e->m_only ? BIT(8) : 0);
+}
+
+static unsigned int hart_pmp_entry_cost(const struct hart_pmp_entry *e)
+{
+	return (e->tor) ? 2 : 1;
+}
+
+static unsigned int hart_pmp_lookup(const struct hart_pmp_entry *ents,
+				    unsigned int count, unsigned long addr)
+{
+	unsigned int i;
+
+	/* Lowest numbered matching entry wins, just like the hardware */
+	for (i = 0; i < count; i++) {
+		if (ents[i].base <= addr && addr <= ents[i].end)
+			return hart_pmp_entry_attr(&ents[i]);
+	}
+
+	return HART_PMP_NO_MATCH;
+}
+
+static bool hart_pmp_same_at(const struct hart_pmp_entry *ref,
+			     unsigned int nref,
+			     const struct hart_pmp_entry *ents,
+			     unsigned int count, unsigned long addr)
+{
+	return hart_pmp_lookup(ref, nref, addr) ==
+	       hart_pmp_lookup(ents, count, addr);
+}
+
+static bool hart_pmp_same_at_bounds(const struct hart_pmp_entry *ref,
+				    unsigned int nref,
+				    const struct hart_pmp_entry *ents,
+				    unsigned int count,
+				    const struct hart_pmp_entry *bounds,
+				    unsigned int nbounds)
+{
+	unsigned int i;
+
+	for (i = 0; i < nbounds; i++) {
+		if (!hart_pmp_same_at(ref, nref, ents, count, bounds[i].base))
+			return false;
+		if (bounds[i].end != -1UL &&
+		    !hart_pmp_same_at(ref, nref, ents, count,
+				      bounds[i].end + 1))
+			return false;
+	}
+
+	return true;
+}
+
+/*
+ * The permission resolved for an address by either entry list can only
+ * change at the boundary of one of its entries, so comparing both lists
+ * at every boundary of both lists proves that they grant identical
+ * permissions over the whole address space.
+ */
+static bool hart_pmp_equivalent(const struct hart_pmp_entry *ref,
+				unsigned int nref,
+				const struct hart_pmp_entry *ents,
+				unsigned int count)
+{
+	if (!hart_pmp_same_at(ref, nref, ents, count, 0))
+		return false;
+	if (!hart_pmp_same_at_bounds(ref, nref, ents, count, ref, nref))
+		return false;
+	return hart_pmp_same_at_bounds(ref, nref, ents, count, ents, count);
+}
+
+/*
+ * Replace entry i with repl and drop entry j (or only drop entry i when
+ * i == j), keeping the change only if the result is still equivalent
+ * to the reference list.
+ */
+static bool hart_pmp_try_replace(struct hart_pmp_entry *ents,
+				 unsigned int *count,
+				 const struct hart_pmp_entry *ref,
+				 unsigned int nref,
+				 struct hart_pmp_entry *tmp,
+				 unsigned int i, unsigned int j,
+				 const struct hart_pmp_entry *repl)
+{
+	unsigned int k, n = 0;
+
+	for (k = 0; k < *count; k++) {
+		if (k == j)
+			continue;
+		tmp[n++] = (k == i) ? *repl : ents[k];
+	}
+
+	if (!hart_pmp_equivalent(ref, nref, tmp, n))
+		return false;
+
+	sbi_memcpy(ents, tmp, n * sizeof(*tmp));
+	*count = n;
+	return true;
+}
+
+static void hart_pmp_plan_drop_redundant(struct hart_pmp_plan *plan,
+					 const struct hart_pmp_entry *ref,
+					 unsigned int nref,
+					 struct hart_pmp_entry *tmp)
+{
+	unsigned int i = 0;
+
+	/* Drop entries which are shadowed or fully implied by others */
+	while (i < plan->count) {
+		if (!hart_pmp_try_replace(plan->ents, &plan->count,
+					  ref, nref, tmp, i, i, NULL))
+			i++;
+	}
+}
+
+static void hart_pmp_plan_merge_napot(struct hart_pmp_plan *plan,
+				      const struct hart_pmp_entry *ref,
+				      unsigned int nref,
+				      struct hart_pmp_entry *tmp)
+{
+	struct hart_pmp_entry *a, *b, repl;
+	unsigned int i, j;
+	bool merged;
+
+	/* Merge buddy NAPOT entries into a NAPOT entry of twice the size */
+	do {
+		merged = false;
+		for (i = 0; i < plan->count; i++) {
+			a = &plan->ents[i];
+			if (a->tor || a->order >= __riscv_xlen)
+				continue;
+
+			for (j = i + 1; j < plan->count; j++) {
+				b = &plan->ents[j];
+				if (b->tor || b->order != a->order ||
+				    hart_pmp_entry_attr(a) !=
+				    hart_pmp_entry_attr(b) ||
+				    (a->base ^ b->base) != BIT(a->order))
+					continue;
+
+				repl = *a;
+				repl.order = a->order + 1;
+				repl.base = a->base & ~BIT(a->order);
+				repl.end = (repl.order < __riscv_xlen) ?
+					   repl.base + BIT(repl.order) - 1 : -1UL;
+				if (hart_pmp_try_replace(plan->ents,
+							 &plan->count, ref,
+							 nref, tmp, i, j,
+							 &repl)) {
+					merged = true;
+					break;
+				}
+			}
+		}
+	} while (merged);
+}
+
+static void hart_pmp_plan_merge_tor(struct hart_pmp_plan *plan,
+				    const struct hart_pmp_entry *ref,
+				    unsigned int nref,
+				    struct hart_pmp_entry *tmp,
+				    struct hart_pmp_entry *work,
+				    unsigned long pmp_addr_max)
+{
+	unsigned int i, j, wi, wcount, old_cost;
+	struct hart_pmp_entry *a, *b, repl;
+	unsigned long lo, hi;
+	bool grown;
+
+	/*
+	 * Grow each entry into a TOR range by absorbing address-adjacent
+	 * entries with the same permissions. A TOR range needs two PMP
+	 * entries so only keep it when it replaces more than that.
+	 */
+	for (i = 0; i < plan->count; i++) {
+		sbi_memcpy(work, plan->ents, plan->count * sizeof(*work));
+		wcount = plan->count;
+		wi = i;
+		old_cost = hart_pmp_entry_cost(&work[wi]);
+
+		do {
+			grown = false;
+			for (j = 0; j < wcount; j++) {
+				a = &work[wi];
+				b = &work[j];
+				if (j == wi || hart_pmp_entry_attr(a) !=
+					       hart_pmp_entry_attr(b))
+					continue;
+
+				if (a->end != -1UL && b->base == a->end + 1) {
+					lo = a->base;
+					hi = b->end;
+				} else if (b->end != -1UL &&
+					   b->end + 1 == a->base) {
+					lo = b->base;
+					hi = a->end;
+				} else
+					continue;
+
+				if (hi == -1UL ||
+				    ((hi + 1) >> PMP_SHIFT) > pmp_addr_max)
+					continue;
+
+				repl = *a;
+				repl.tor = true;
+				repl.order = 0;
+				repl.base = lo;
+				repl.end = hi;
+				old_cost += hart_pmp_entry_cost(b);
+				if (!hart_pmp_try_replace(work, &wcount, ref,
+							  nref, tmp, wi, j,
+							  &repl)) {
+					old_cost -= hart_pmp_entry_cost(b);
+					continue;
+				}
+
+				if (j < wi)
+					wi--;
+				grown = true;
+				break;
+			}
+		} while (grown);
+
+		if (old_cost > hart_pmp_entry_cost(&work[wi])) {
+			sbi_memcpy(plan->ents, work, wcount * sizeof(*work));
+			plan->count = wcount;
+			i = wi;
+		}
+	}
+}
+
+static void hart_pmp_plan_layout(struct hart_pmp_plan *plan, bool smepmp)
+{
+	struct hart_pmp_entry *e, *prev = NULL;
+	unsigned int i, idx = 0;
+
+	for (i = 0; i < plan->count; i++) {
+		e = &plan->ents[i];
+
+		/* Skip reserved entries */
+		if (smepmp && idx < SBI_SMEPMP_RESV_COUNT) {
+			idx = SBI_SMEPMP_RESV_COUNT;
+			prev = NULL;
+		}
+
+		/*
+		 * A TOR entry can share its bottom bound with a TOR entry
+		 * ending at the same address or with the implicit zero
+		 * bound of entry 0, otherwise it needs a disabled entry
+		 * in front of it to hold the bound.
+		 */
+		e->lo_slot = false;
+		if (e->tor && !(idx == 0 && e->base == 0) &&
+		    !(prev && prev->tor && prev->end + 1 == e->base)) {
+			e->lo_slot = true;
+			idx++;
+		}
+
+		e->idx = idx++;
+		prev = e;
+	}
+
+	plan->slots = idx;
+}
+
+static struct hart_pmp_plan *hart_pmp_plan_build(struct sbi_scratch *scratch,
+						 struct sbi_domain *dom,
+						 unsigned int nregions,
+						 bool smepmp,
+						 unsigned int pmp_gran_log2,
+						 unsigned long pmp_addr_max)
+{
+	struct hart_pmp_entry *ref = NULL, *tmp, *work, *e;
+	struct sbi_domain_memregion *reg;
+	struct hart_pmp_plan *plan;
+	unsigned int nref = 0, ref_slots;
+	unsigned int pmp_flags;
+
+	plan = sbi_zalloc(sizeof(*plan) + nregions * sizeof(*plan->ents));
+	if (!plan || !nregions)
+		goto fail;
+
+	ref = sbi_calloc(3 * nregions, sizeof(*ref));
+	if (!ref)
+		goto fail;
+	tmp = &ref[nregions];
+	work = &ref[2 * nregions];
+
+	/* Reference list with one entry per programmable region */
+	sbi_domain_for_each_memregion(dom, reg) {
+		if (smepmp) {
+			pmp_flags = sbi_hart_get_smepmp_flags(scratch, dom, reg);
+			if (!pmp_flags)
+				goto fail;
+		} else {
+			pmp_flags = sbi_hart_get_oldpmp_flags(reg);
+		}
+
+		if (pmp_gran_log2 > reg->order ||
+		    (reg->base >> PMP_SHIFT) >= pmp_addr_max)
+			continue;
+
+		e = &ref[nref++];
+		e->base = reg->base;
+		e->end = (reg->order < __riscv_xlen) ?
+			 reg->base + BIT(reg->order) - 1 : -1UL;
+		e->order = reg->order;
+		e->flags = pmp_flags;
+		e->m_only = smepmp &&
+			    SBI_DOMAIN_MEMREGION_M_ONLY_ACCESS(reg->flags);
+	}
+
+	plan->dom = dom;
+	plan->nregions = nregions;
+	plan->count = nref;
+	sbi_memcpy(plan->ents, ref, nref * sizeof(*ref));
+
+	hart_pmp_plan_drop_redundant(plan, ref, nref, tmp);
+	hart_pmp_plan_merge_napot(plan, ref, nref, tmp);
+	hart_pmp_plan_merge_tor(plan, ref, nref, tmp, work, pmp_addr_max);
+
+	/* Final check before trusting the plan with the PMP */
+	if (!hart_pmp_equivalent(ref, nref, plan->ents, plan->count))
+		goto fail;
+
+	hart_pmp_plan_layout(plan, smepmp);
+	ref_slots = nref + ((smepmp) ? SBI_SMEPMP_RESV_COUNT : 0);
+	plan->saved = (ref_slots > plan->slots) ? ref_slots - plan->slots : 0;
+
+	sbi_free(ref);
+	return plan;
+
+fail:
+	sbi_free(ref);
+	sbi_free(plan);
+	return NULL;
+}
+
+static void hart_pmp_params(struct sbi_scratch *scratch,
+			    unsigned int *pmp_gran_log2,
+			    unsigned long *pmp_addr_max)
+{
+	unsigned int pmp_bits = sbi_hart_pmp_addrbits(scratch) - 1;
+
+	*pmp_gran_log2 = log2roundup(sbi_hart_pmp_granularity(scratch));
+	*pmp_addr_max = (1UL << pmp_bits) | ((1UL << pmp_bits) - 1);
+}
+
+/* Returns the per-HART PMP plan cache, allocating it on first use */
+static struct hart_pmp_plan_cache *hart_pmp_plan_cache(
+					struct sbi_scratch *scratch)
+{
+	struct hart_pmp_plan_cache *cache;
+
+	if (!hart_pmp_plan_offset)
+		return NULL;
+
+	cache = sbi_scratch_read_type(scratch, struct hart_pmp_plan_cache *,
+				      hart_pmp_plan_offset);
+	if (!cache) {
+		cache = sbi_zalloc(sizeof(*cache));
+		sbi_scratch_write_type(scratch, struct hart_pmp_plan_cache *,
+				       hart_pmp_plan_offset, cache);
+	}
+
+	return cache;
+}
+
+/*
+ * Returns the cached PMP plan of a domain on this HART, computing it
+ * on first use. Returns NULL when no plan is available in which case
+ * regions are programmed one per PMP entry.
+ */
+static struct hart_pmp_plan *hart_pmp_plan_get(struct sbi_scratch *scratch,
+					       struct sbi_domain *dom,
+					       unsigned int pmp_gran_log2,
+					       unsigned long pmp_addr_max)
+{
+	struct hart_pmp_plan_cache *cache = hart_pmp_plan_cache(scratch);
+	struct sbi_domain_memregion *reg;
+	struct hart_pmp_plan **plan;
+	unsigned int nregions = 0;
+
+	if (!cache || !dom || SBI_DOMAIN_MAX_INDEX <= dom->index)
+		return NULL;
+
+	sbi_domain_for_each_memregion(dom, reg)
+		nregions++;
+
+	plan = &cache->plans[dom->index];
+	if (*plan && (*plan)->dom == dom && (*plan)->nregions == nregions)
+		return *plan;
+
+	if (cache->active == *plan)
+		cache->active = NULL;
+	sbi_free(*plan);
+	*plan = hart_pmp_plan_build(scratch, dom, nregions,
+			sbi_hart_has_extension(scratch, SBI_HART_EXT_SMEPMP),
+			pmp_gran_log2, pmp_addr_max);
+	return *plan;
+}
+
+static void hart_pmp_plan_set_active(struct sbi_scratch *scratch,
+				     struct hart_pmp_plan *plan)
+{
+	struct hart_pmp_plan_cache *cache = hart_pmp_plan_cache(scratch);
+
+	if (cache)
+		cache->active = plan;
+}
+
+static void hart_pmp_entry_program(const struct hart_pmp_entry *e)
+{
+	if (e->tor) {
+		if (e->lo_slot)
+			pmp_disable(e->idx - 1);
+		pmp_set_tor(e->idx, e->flags, e->base, e->end - e->base + 1);
+	} else {
+		pmp_set(e->idx, e->flags, e->base, e->order);
+	}
+}
+
+static void hart_pmp_plan_program(const struct hart_pmp_plan *plan,
+				  unsigned int pmp_count, bool smepmp,
+				  bool m_only)
+{
+	const struct hart_pmp_entry *e;
+	unsigned int i;
+
+	for (i = 0; i < plan->count; i++) {
+		e = &plan->ents[i];
+		if (pmp_count <= e->idx)
+			break;
+		if (smepmp && e->m_only != m_only)
+			continue;
+
+		hart_pmp_entry_program(e);
+	}
+}
+
+/*
+ * Returns what a plan puts in a PMP entry: NULL for an unused entry,
+ * otherwise the planned entry with lo set if the PMP entry only holds
+ * the bottom bound of that (TOR) entry. The pos cursor must be reused
+ * for increasing slot numbers.
+ */
+static const struct hart_pmp_entry *hart_pmp_plan_slot(
+					const struct hart_pmp_plan *plan,
+					unsigned int *pos, unsigned int slot,
+					bool *lo)
+{
+	const struct hart_pmp_entry *e;
+
+	*lo = false;
+	while (*pos < plan->count && plan->ents[*pos].idx < slot)
+		(*pos)++;
+	if (plan->count <= *pos)
+		return NULL;
+
+	e = &plan->ents[*pos];
+	if (e->idx == slot)
+		return e;
+	if (e->lo_slot && e->idx == slot + 1) {
+		*lo = true;
+		return e;
+	}
+
+	return NULL;
+}
+
+static bool hart_pmp_slot_same(const struct hart_pmp_entry *a, bool alo,
+			       const struct hart_pmp_entry *b, bool blo)
+{
+	if (!a || !b)
+		return a == b;
+	if (alo != blo)
+		return false;
+	if (alo)
+		return a->base == b->base;
+
+	return a->tor == b->tor && a->lo_slot == b->lo_slot &&
+	       a->base == b->base && a->end == b->end &&
+	       a->order == b->order && a->flags == b->flags;
+}
+
+/* Reprogram only the PMP entries which differ between two plans */
+static unsigned int hart_pmp_plan_switch(const struct hart_pmp_plan *from,
+					 const struct hart_pmp_plan *to,
+					 unsigned int pmp_count)
+{
+	unsigned int slot, nslots, fpos = 0, tpos = 0, written = 0;
+	const struct hart_pmp_entry *fe, *te;
+	bool flo, tlo, dirty_lo = false;
+
+	nslots = (from->slots < to->slots) ? to->slots : from->slots;
+	if (pmp_count < nslots)
+		nslots = pmp_count;
+
+	for (slot = 0; slot < nslots; slot++) {
+		fe = hart_pmp_plan_slot(from, &fpos, slot, &flo);
+		te = hart_pmp_plan_slot(to, &tpos, slot, &tlo);
+		if (!dirty_lo && hart_pmp_slot_same(fe, flo, te, tlo))
+			continue;
+
+		/*
+		 * A changed bottom bound is written together with the TOR
+		 * entry in the next PMP entry.
+		 */
+		dirty_lo = false;
+		if (!te) {
+			pmp_disable(slot);
+			written++;
+		} else if (tlo) {
+			dirty_lo = true;
+		} else {
+			hart_pmp_entry_program(te);
+			written++;
+		}
+	}
+
+	return written;
+}
+
+unsigned int sbi_hart_pmp_used(struct sbi_scratch *scratch,
+			       unsigned int *saved)
+{
+	struct hart_pmp_plan *plan;
+	unsigned int pmp_gran_log2;
+	unsigned long pmp_addr_max;
+
+	*saved = 0;
+	if (!sbi_hart_pmp_count(scratch))
+		return 0;
+
+	hart_pmp_params(scratch, &pmp_gran_log2, &pmp_addr_max);
+	plan = hart_pmp_plan_get(scratch, sbi_domain_thishart_ptr(),
+				 pmp_gran_log2, pmp_addr_max);
+	if (!plan)
+		return 0;
+
+	*saved = plan->saved;
+	return (plan->slots < sbi_hart_pmp_count(scratch)) ?
+		plan->slots : sbi_hart_pmp_count(scratch);
+}
+
+/** Shared memory window mapped in a reserved Smepmp PMP entry */
+struct hart_saddr_window {
+	/** Base address of the NAPOT window */
+	unsigned long base;
+	/** NAPOT order of the window */
+	unsigned long order;
+	/** LRU timestamp of the last use (zero when unused) */
+	unsigned long last_use;
+};
+
+/** Per-HART cache of the reserved Smepmp PMP entries */
+struct hart_saddr_cache {
+	/** Counter used for LRU timestamps */
+	unsigned long clock;
+	/** Bitmap of windows to disable on unmap */
+	unsigned long unmap_mask;
+	/** Windows indexed by reserved PMP entry */
+	struct hart_saddr_window win[SBI_SMEPMP_RESV_COUNT];
+};
+
+static unsigned long hart_saddr_cache_offset;
+
+static bool hart_saddr_window_covers(const struct hart_saddr_window *win,
+				     unsigned long addr, unsigned long size)
+{
+	if (!win->last_use || addr < win->base)
+		return false;
+	if (win->order >= __riscv_xlen)
+		return true;
+
+	return (addr + size - 1UL) - win->base < BIT(win->order);
+}
+
+static void hart_saddr_reset(struct sbi_scratch *scratch)
+{
+	struct hart_saddr_cache *cache =
+		sbi_scratch_offset_ptr(scratch, hart_saddr_cache_offset);
+	unsigned int i;
+
+	for (i = 0; i < SBI_SMEPMP_RESV_COUNT; i++)
+		pmp_disable(SBI_SMEPMP_RESV_ENTRY + i);
+	sbi_memset(cache, 0, sizeof(*cache));
+}
+
 static int sbi_hart_smepmp_configure(struct sbi_scratch *scratch,
 				     unsigned int pmp_count,
 				     unsigned int pmp_gran_log2,
@@ -375,6 +1096,7 @@ static int sbi_hart_smepmp_configure(struct sbi_scratch *scratch,
 {
 	struct sbi_domain_memregion *reg;
 	struct sbi_domain *dom = sbi_domain_thishart_ptr();
+	struct hart_pmp_plan *plan;
 	unsigned int pmp_idx, pmp_flags;
 
 	/*
@@ -383,15 +1105,30 @@ static int sbi_hart_smepmp_configure(struct sbi_scratch *scratch,
 	 */
 	csr_set(CSR_MSECCFG, MSECCFG_RLB);
 
-	/* Disable the reserved entry */
-	pmp_disable(SBI_SMEPMP_RESV_ENTRY);
+	/* Disable the reserved entries */
+	hart_saddr_reset(scratch);
+
+	plan = hart_pmp_plan_get(scratch, dom, pmp_gran_log2, pmp_addr_max);
+	if (plan) {
+		/* Program M-only entries when MML is not set. */
+		hart_pmp_plan_program(plan, pmp_count, true, true);
+
+		/* Set the MML to enforce new encoding */
+		csr_set(CSR_MSECCFG, MSECCFG_MML);
+
+		/* Program shared and SU-only entries */
+		hart_pmp_plan_program(plan, pmp_count, true, false);
+		hart_pmp_plan_set_active(scratch, plan);
+		return 0;
+	}
+	hart_pmp_plan_set_active(scratch, NULL);
 
 	/* Program M-only regions when MML is not set. */
 	pmp_idx = 0;
 	sbi_domain_for_each_memregion(dom, reg) {
-		/* Skip reserved entry */
-		if (pmp_idx == SBI_SMEPMP_RESV_ENTRY)
-			pmp_idx++;
+		/* Skip reserved entries */
+		if (pmp_idx < SBI_SMEPMP_RESV_COUNT)
+			pmp_idx = SBI_SMEPMP_RESV_COUNT;
 		if (pmp_count <= pmp_idx)
 			break;
 
@@ -415,9 +1152,9 @@ static int sbi_hart_smepmp_configure(struct sbi_scratch *scratch,
 	/* Program shared and SU-only regions */
 	pmp_idx = 0;
 	sbi_domain_for_each_memregion(dom, reg) {
-		/* Skip reserved entry */
-		if (pmp_idx == SBI_SMEPMP_RESV_ENTRY)
-			pmp_idx++;
+		/* Skip reserved entries */
+		if (pmp_idx < SBI_SMEPMP_RESV_COUNT)
+			pmp_idx = SBI_SMEPMP_RESV_COUNT;
 		if (pmp_count <= pmp_idx)
 			break;
 
@@ -450,29 +1187,24 @@ static int sbi_hart_oldpmp_configure(struct sbi_scratch *scratch,
 {
 	struct sbi_domain_memregion *reg;
 	struct sbi_domain *dom = sbi_domain_thishart_ptr();
+	struct hart_pmp_plan *plan;
 	unsigned int pmp_idx = 0;
 	unsigned int pmp_flags;
 	unsigned long pmp_addr;
 
+	plan = hart_pmp_plan_get(scratch, dom, pmp_gran_log2, pmp_addr_max);
+	if (plan) {
+		hart_pmp_plan_program(plan, pmp_count, false, false);
+		hart_pmp_plan_set_active(scratch, plan);
+		return 0;
+	}
+	hart_pmp_plan_set_active(scratch, NULL);
+
 	sbi_domain_for_each_memregion(dom, reg) {
 		if (pmp_count <= pmp_idx)
 			break;
 
-		pmp_flags = 0;
-
-		/*
-		 * If permissions are to be enforced for all modes on
-		 * this region, the lock bit should be set.
-		 */
-		if (reg->flags & SBI_DOMAIN_MEMREGION_ENF_PERMISSIONS)
-			pmp_flags |= PMP_L;
-
-		if (reg->flags & SBI_DOMAIN_MEMREGION_SU_READABLE)
-			pmp_flags |= PMP_R;
-		if (reg->flags & SBI_DOMAIN_MEMREGION_SU_WRITABLE)
-			pmp_flags |= PMP_W;
-		if (reg->flags & SBI_DOMAIN_MEMREGION_SU_EXECUTABLE)
-			pmp_flags |= PMP_X;
+		pmp_flags = sbi_hart_get_oldpmp_flags(reg);
 
 		pmp_addr = reg->base >> PMP_SHIFT;
 		if (pmp_gran_log2 <= reg->order && pmp_addr < pmp_addr_max) {
@@ -488,19 +1220,50 @@ static int sbi_hart_oldpmp_configure(struct sbi_scratch *scratch,
 	return 0;
 }
 
-int sbi_hart_map_saddr(unsigned long addr, unsigned long size)
+/*
+ * A window may only stay mapped while S-mode runs if S-mode can read and
+ * write its whole NAPOT range anyway, otherwise the shared M and S/U
+ * permissions of the reserved entry would open up M-only memory.
+ */
+static bool hart_saddr_window_keepable(unsigned long base,
+				       unsigned long order)
+{
+	const struct sbi_domain *dom = sbi_domain_thishart_ptr();
+
+	if (!dom || order >= __riscv_xlen)
+		return false;
+
+	return sbi_domain_check_addr_range(dom, base, BIT(order), PRV_S,
+					   SBI_DOMAIN_READ | SBI_DOMAIN_WRITE);
+}
+
+static int hart_map_saddr(unsigned long addr, unsigned long size, bool keep)
 {
 	/* shared R/W access for M and S/U mode */
 	unsigned int pmp_flags = (PMP_W | PMP_X);
 	unsigned long order, base = 0;
 	struct sbi_scratch *scratch = sbi_scratch_thishart_ptr();
+	struct hart_saddr_cache *cache;
+	unsigned int i, victim = 0;
 
 	/* If Smepmp is not supported no special mapping is required */
 	if (!sbi_hart_has_extension(scratch, SBI_HART_EXT_SMEPMP))
 		return SBI_OK;
 
-	if (is_pmp_entry_mapped(SBI_SMEPMP_RESV_ENTRY))
-		return SBI_ENOSPC;
+	if (!size || (addr + size - 1UL) < addr)
+		return SBI_EINVAL;
+
+	/* Reuse a window which is still mapped from an earlier call */
+	cache = sbi_scratch_offset_ptr(scratch, hart_saddr_cache_offset);
+	cache->clock++;
+	for (i = 0; i < SBI_SMEPMP_RESV_COUNT; i++) {
+		if (hart_saddr_window_covers(&cache->win[i], addr, size)) {
+			cache->win[i].last_use = cache->clock;
+			return SBI_OK;
+		}
+		if (cache->win[i].last_use < cache->win[victim].last_use)
+			victim = i;
+	}
 
 	for (order = log2roundup(size) ; order <= __riscv_xlen; order++) {
 		if (order < __riscv_xlen) {
@@ -515,34 +1278,93 @@ int sbi_hart_map_saddr(unsigned long addr, unsigned long size)
 		}
 	}
 
-	pmp_set(SBI_SMEPMP_RESV_ENTRY, pmp_flags, base, order);
+	/* Replace an unused or the least recently used window */
+	pmp_set(SBI_SMEPMP_RESV_ENTRY + victim, pmp_flags, base, order);
+	cache->win[victim].base = base;
+	cache->win[victim].order = order;
+	cache->win[victim].last_use = cache->clock;
+
+	if (!keep || !hart_saddr_window_keepable(base, order))
+		cache->unmap_mask |= BIT(victim);
 
 	return SBI_OK;
 }
 
+int sbi_hart_map_saddr(unsigned long addr, unsigned long size)
+{
+	return hart_map_saddr(addr, size, false);
+}
+
+int sbi_hart_map_registered_saddr(unsigned long addr, unsigned long size)
+{
+	return hart_map_saddr(addr, size, true);
+}
+
 int sbi_hart_unmap_saddr(void)
 {
 	struct sbi_scratch *scratch = sbi_scratch_thishart_ptr();
+	struct hart_saddr_cache *cache;
+	unsigned int i;
 
 	if (!sbi_hart_has_extension(scratch, SBI_HART_EXT_SMEPMP))
 		return SBI_OK;
 
-	return pmp_disable(SBI_SMEPMP_RESV_ENTRY);
+	/*
+	 * Only windows mapped for registered shared memory whose whole
+	 * range is S-mode read/write memory stay mapped, they are dropped
+	 * by LRU replacement, sbi_hart_invalidate_saddr() or when the PMP
+	 * of this HART is configured again.
+	 */
+	cache = sbi_scratch_offset_ptr(scratch, hart_saddr_cache_offset);
+	for (i = 0; i < SBI_SMEPMP_RESV_COUNT; i++) {
+		if (!(cache->unmap_mask & BIT(i)))
+			continue;
+		pmp_disable(SBI_SMEPMP_RESV_ENTRY + i);
+		cache->win[i].last_use = 0;
+	}
+	cache->unmap_mask = 0;
+
+	return SBI_OK;
+}
+
+void sbi_hart_invalidate_saddr(unsigned long addr, unsigned long size)
+{
+	struct sbi_scratch *scratch = sbi_scratch_thishart_ptr();
+	struct hart_saddr_cache *cache;
+	struct hart_saddr_window *win;
+	unsigned long win_end;
+	unsigned int i;
+
+	if (!sbi_hart_has_extension(scratch, SBI_HART_EXT_SMEPMP) || !size)
+		return;
+
+	cache = sbi_scratch_offset_ptr(scratch, hart_saddr_cache_offset);
+	for (i = 0; i < SBI_SMEPMP_RESV_COUNT; i++) {
+		win = &cache->win[i];
+		if (!win->last_use)
+			continue;
+
+		win_end = (win->order < __riscv_xlen) ?
+			  win->base + BIT(win->order) - 1 : -1UL;
+		if (win_end < addr || (addr + size - 1UL) < win->base)
+			continue;
+
+		pmp_disable(SBI_SMEPMP_RESV_ENTRY + i);
+		win->last_use = 0;
+	}
 }
 
 int sbi_hart_pmp_configure(struct sbi_scratch *scratch)
 {
 	int rc;
-	unsigned int pmp_bits, pmp_gran_log2;
+	unsigned int pmp_gran_log2;
 	unsigned int pmp_count = sbi_hart_pmp_count(scratch);
 	unsigned long pmp_addr_max;
 
 	if (!pmp_count)
 		return 0;
 
-	pmp_gran_log2 = log2roundup(sbi_hart_pmp_granularity(scratch));
-	pmp_bits = sbi_hart_pmp_addrbits(scratch) - 1;
-	pmp_addr_max = (1UL << pmp_bits) | ((1UL << pmp_bits) - 1);
+	hart_pmp_params(scratch, &pmp_gran_log2, &pmp_addr_max);
 
 	if (sbi_hart_has_extension(scratch, SBI_HART_EXT_SMEPMP))
 		rc = sbi_hart_smepmp_configure(scratch, pmp_count,
@@ -575,6 +1397,34 @@ int sbi_hart_pmp_configure(struct sbi_scratch *scratch)
 	return rc;
 }
 
+int sbi_hart_pmp_switch(struct sbi_scratch *scratch)
+{
+	unsigned int pmp_count = sbi_hart_pmp_count(scratch);
+	struct hart_pmp_plan_cache *cache;
+	struct hart_pmp_plan *plan;
+	unsigned int pmp_gran_log2;
+	unsigned long pmp_addr_max;
+
+	if (!pmp_count)
+		return 0;
+
+	hart_pmp_params(scratch, &pmp_gran_log2, &pmp_addr_max);
+	plan = hart_pmp_plan_get(scratch, sbi_domain_thishart_ptr(),
+				 pmp_gran_log2, pmp_addr_max);
+	cache = hart_pmp_plan_cache(scratch);
+	if (!plan || !cache || !cache->active)
+		return sbi_hart_pmp_configure(scratch);
+
+	/* Shared memory windows belong to the previous domain */
+	if (sbi_hart_has_extension(scratch, SBI_HART_EXT_SMEPMP))
+		hart_saddr_reset(scratch);
+
+	hart_pmp_plan_switch(cache->active, plan, pmp_count);
+	cache->active = plan;
+
+	return 0;
+}
+
 int sbi_hart_priv_version(struct sbi_scratch *scratch)
 {
 	struct sbi_hart_features *hfeatures =
@@ -634,6 +1484,7 @@ void sbi_hart_update_extension(struct sbi_scratch *scratch,
 			sbi_scratch_offset_ptr(scratch, hart_features_offset);
 
 	__sbi_hart_update_extension(hfeatures, ext, enable);
+	scratch->hot.extensions = hfeatures->extensions;
 }
 
 /**
@@ -646,10 +1497,7 @@ void sbi_hart_update_extension(struct sbi_scratch *scratch,
 bool sbi_hart_has_extension(struct sbi_scratch *scratch,
 			    enum sbi_hart_extensions ext)
 {
-	struct sbi_hart_features *hfeatures =
-			sbi_scratch_offset_ptr(scratch, hart_features_offset);
-
-	if (hfeatures->extensions & BIT(ext))
+	if (scratch->hot.extensions & BIT(ext))
 		return true;
 	else
 		return false;
@@ -684,6 +1532,12 @@ static inline char *sbi_hart_extension_id2string(int ext)
 	case SBI_HART_EXT_SMCNTRPMF:
 		estr = "smcntrpmf";
 		break;
+	case SBI_HART_EXT_SMCDELEG:
+		estr = "smcdeleg";
+		break;
+	case SBI_HART_EXT_SSCCFG:
+		estr = "ssccfg";
+		break;
 	default:
 		break;
 	}
@@ -786,11 +1640,142 @@ static int hart_mhpm_get_allowed_bits(void)
 	return num_bits;
 }
 
+/**
+ * Probed features shared by identical HARTs
+ *
+ * On platforms which opt in, HARTs with the same mvendorid, marchid,
+ * mimpid and misa implement the same CSRs. The first HART of a class
+ * does the full trap based probing and others copy its result after a
+ * few spot checks. Extensions found only by trap based probing are not
+ * checked again, so the platform must not opt in if such HARTs differ.
+ */
+struct hart_feature_class {
+	struct sbi_dlist head;
+	unsigned long mvendorid;
+	unsigned long marchid;
+	unsigned long mimpid;
+	unsigned long misa;
+	/* Features as probed, before the platform populated extensions */
+	struct sbi_hart_features features;
+};
+
+static SBI_LIST_HEAD(hart_feature_classes);
+static spinlock_t hart_feature_classes_lock = SPIN_LOCK_INITIALIZER;
+
+static void hart_feature_class_key(struct hart_feature_class *key)
+{
+	key->mvendorid = csr_read(CSR_MVENDORID);
+	key->marchid = csr_read(CSR_MARCHID);
+	key->mimpid = csr_read(CSR_MIMPID);
+	key->misa = csr_read(CSR_MISA);
+}
+
+/* Cheap checks that the HART really implements the cached features */
+static bool hart_feature_class_check(const struct sbi_hart_features *hf)
+{
+	struct sbi_trap_info trap = {0};
+	unsigned long val, oldval;
+	bool implemented;
+	int last;
+
+	if (hf->pmp_count) {
+		val = hart_pmp_get_allowed_addr();
+		if (!val || hf->pmp_gran != (1UL << (sbi_ffs(val) + 2)) ||
+		    hf->pmp_addr_bits != sbi_fls(val) + 1)
+			return false;
+
+		/* The last PMP entry must be implemented as well */
+		last = CSR_PMPADDR0 + hf->pmp_count - 1;
+		oldval = csr_read_num(last);
+		csr_write_num(last, val);
+		implemented = csr_read_num(last) == val;
+		csr_write_num(last, oldval);
+		if (!implemented)
+			return false;
+	}
+
+	if (hf->mhpm_bits != hart_mhpm_get_allowed_bits())
+		return false;
+
+	if (hf->priv_version >= SBI_HART_PRIV_VER_1_12)
+		csr_read_allowed(CSR_MENVCFG, (ulong)&trap);
+	else if (hf->priv_version >= SBI_HART_PRIV_VER_1_11)
+		csr_read_allowed(CSR_MCOUNTINHIBIT, (ulong)&trap);
+	else if (hf->priv_version >= SBI_HART_PRIV_VER_1_10)
+		csr_read_allowed(CSR_MCOUNTEREN, (ulong)&trap);
+
+	return trap.cause ? false : true;
+}
+
+static bool hart_feature_class_match(const struct hart_feature_class *a,
+				     const struct hart_feature_class *b)
+{
+	return a->mvendorid == b->mvendorid && a->marchid == b->marchid &&
+	       a->mimpid == b->mimpid && a->misa == b->misa;
+}
+
+static bool hart_feature_class_get(const struct hart_feature_class *key,
+				   struct sbi_hart_features *hfeatures)
+{
+	struct hart_feature_class *hfc;
+	bool found = false;
+
+	if (!sbi_platform_has_hart_feature_cache(sbi_platform_thishart_ptr()))
+		return false;
+
+	spin_lock(&hart_feature_classes_lock);
+	sbi_list_for_each_entry(hfc, &hart_feature_classes, head) {
+		if (hart_feature_class_match(hfc, key)) {
+			*hfeatures = hfc->features;
+			found = true;
+			break;
+		}
+	}
+	spin_unlock(&hart_feature_classes_lock);
+
+	if (found && !hart_feature_class_check(hfeatures)) {
+		sbi_printf("%s: hart%u differs from identical HARTs, "
+			   "probing all features\n", __func__, current_hartid());
+		found = false;
+	}
+
+	return found;
+}
+
+static void hart_feature_class_add(const struct hart_feature_class *key,
+				   const struct sbi_hart_features *hfeatures)
+{
+	struct hart_feature_class *hfc, *iter;
+
+	if (!sbi_platform_has_hart_feature_cache(sbi_platform_thishart_ptr()))
+		return;
+
+	/* Without a class entry the next HART simply probes again */
+	hfc = sbi_zalloc(sizeof(*hfc));
+	if (!hfc)
+		return;
+	*hfc = *key;
+	hfc->features = *hfeatures;
+	SBI_INIT_LIST_HEAD(&hfc->head);
+
+	spin_lock(&hart_feature_classes_lock);
+	sbi_list_for_each_entry(iter, &hart_feature_classes, head) {
+		if (hart_feature_class_match(iter, key)) {
+			spin_unlock(&hart_feature_classes_lock);
+			sbi_free(hfc);
+			return;
+		}
+	}
+	sbi_list_add_tail(&hfc->head, &hart_feature_classes);
+	spin_unlock(&hart_feature_classes_lock);
+}
+
 static int hart_detect_features(struct sbi_scratch *scratch)
 {
 	struct sbi_trap_info trap = {0};
 	struct sbi_hart_features *hfeatures =
 		sbi_scratch_offset_ptr(scratch, hart_features_offset);
+	struct hart_feature_class key;
 	unsigned long val, oldval;
 	int rc;
 
@@ -803,6 +1788,11 @@ static int hart_detect_features(struct sbi_scratch *scratch)
 	hfeatures->pmp_count = 0;
 	hfeatures->mhpm_mask = 0;
 
+	/* Copy the features of an identical HART probed earlier */
+	hart_feature_class_key(&key);
+	if (hart_feature_class_get(&key, hfeatures))
+		goto __platform_init;
+
 #define __check_hpm_csr(__csr, __mask) 					  \
 	oldval = csr_read_allowed(__csr, (ulong)&trap);			  \
 	if (!trap.cause) {						  \
@@ -956,6 +1946,34 @@ __pmp_skip:
 					SBI_HART_EXT_SMCNTRPMF, true);
 	}
 
+	/*
+	 * Detect if hart supports counter delegation. Smcdeleg needs
+	 * the Sscsrind indirect CSR access and a writable menvcfg.CDE.
+	 */
+	if (hfeatures->priv_version >= SBI_HART_PRIV_VER_1_12) {
+		csr_read_allowed(CSR_SCOUNTINHIBIT, (unsigned long)&trap);
+		if (!trap.cause)
+			__sbi_hart_update_extension(hfeatures,
+					SBI_HART_EXT_SSCCFG, true);
+
+		csr_read_allowed(CSR_SISELECT, (unsigned long)&trap);
+		if (!trap.cause) {
+#if __riscv_xlen == 32
+			oldval = csr_read_set(CSR_MENVCFGH, ENVCFGH_CDE);
+			val = csr_swap(CSR_MENVCFGH, oldval) & ENVCFGH_CDE;
+#else
+			oldval = csr_read_set(CSR_MENVCFG, ENVCFG_CDE);
+			val = csr_swap(CSR_MENVCFG, oldval) & ENVCFG_CDE;
+#endif
+			if (val)
+				__sbi_hart_update_extension(hfeatures,
+						SBI_HART_EXT_SMCDELEG, true);
+		}
+	}
+
+	hart_feature_class_add(&key, hfeatures);
+
+__platform_init:
 	/* Let platform populate extensions */
 	rc = sbi_platform_extensions_init(sbi_platform_thishart_ptr(),
 					  hfeatures);
@@ -975,15 +1993,20 @@ __pmp_skip:
 
 int sbi_hart_reinit(struct sbi_scratch *scratch)
 {
+	struct hart_boot_csrs *bc =
+		sbi_scratch_offset_ptr(scratch, hart_boot_csrs_offset);
 	int rc;
 
-	mstatus_init(scratch);
+	if (!bc->valid || bc->extensions != scratch->hot.extensions)
+		hart_boot_csrs_build(scratch, bc);
+
+	mstatus_init(scratch, bc);
 
 	rc = fp_init(scratch);
 	if (rc)
 		return rc;
 
-	rc = delegate_traps(scratch);
+	rc = delegate_traps(bc);
 	if (rc)
 		return rc;
 
@@ -992,6 +2015,7 @@ int sbi_hart_reinit(struct sbi_scratch *scratch)
 
 int sbi_hart_init(struct sbi_scratch *scratch, bool cold_boot)
 {
+	struct sbi_hart_features *hfeatures;
 	int rc;
 
 	/*
@@ -1004,21 +2028,44 @@ int sbi_hart_init(struct sbi_scratch *scratch, bool cold_boot)
 		if (misa_extension('H'))
 			sbi_hart_expected_trap = &__sbi_expected_trap_hext;
 
-		hart_features_offset = sbi_scratch_alloc_offset(
-					sizeof(struct sbi_hart_features));
+		hart_features_offset = sbi_scratch_alloc_class_offset(
+					sizeof(struct sbi_hart_features),
+					SBI_SCRATCH_ALLOC_LOCAL_HOT);
 		if (!hart_features_offset)
 			return SBI_ENOMEM;
+
+		hart_saddr_cache_offset = sbi_scratch_alloc_class_type_offset(
+					struct hart_saddr_cache,
+					SBI_SCRATCH_ALLOC_LOCAL_HOT);
+		if (!hart_saddr_cache_offset)
+			return SBI_ENOMEM;
+
+		hart_boot_csrs_offset = sbi_scratch_alloc_type_offset(
+					struct hart_boot_csrs);
+		if (!hart_boot_csrs_offset)
+			return SBI_ENOMEM;
+
+		/* PMP plans are optional so ignore allocation failure */
+		hart_pmp_plan_offset = sbi_scratch_alloc_type_offset(
+					struct hart_pmp_plan_cache *);
 	}
 
 	rc = hart_detect_features(scratch);
 	if (rc)
 		return rc;
 
+	/* Mirror the extensions in the hot context for fast checks */
+	hfeatures = sbi_scratch_offset_ptr(scratch, hart_features_offset);
+	scratch->hot.extensions = hfeatures->extensions;
+
 	return sbi_hart_reinit(scratch);
 }
 
 void __attribute__((noreturn)) sbi_hart_hang(void)
 {
+	/* Don't leave deferred console output behind */
+	sbi_console_flush();
+
 	while (1)
 		wfi();
 	__builtin_unreachable();
@@ -32,21 +32,59 @@
 	if (state != (oldstate))					\
 		sbi_printf("%s: ERR: The hart is in invalid state [%lu]\n", \
 			   __func__, state);				\
+	else								\
+		hsm_interruptible_update(hdata, newstate);		\
 	state == (oldstate);						\
 })
 
 static const struct sbi_hsm_device *hsm_dev = NULL;
 static unsigned long hart_data_offset;
 
+/*
+ * HART indices of all HARTs in STARTED or SUSPENDED state, kept in sync
+ * with the per-HART state so that sbi_hsm_hart_interruptible_mask() does
+ * not have to visit the HSM data of every HART.
+ */
+static struct sbi_hartmask hsm_interruptible_harts;
+
+/* True if every valid HART id is equal to its HART index */
+static bool hsm_hartid_is_hartindex;
+
 /** Per hart specific data to manage state transition **/
 struct sbi_hsm_data {
 	atomic_t state;
+	u32 hartindex;
 	unsigned long suspend_type;
 	unsigned long saved_mie;
 	unsigned long saved_mip;
 	atomic_t start_ticket;
+	/* Time of the pending start request, zero if none */
+	u64 start_time;
+	/* Longest start request to S-mode entry seen so far */
+	u64 start_latency_max;
+#ifdef CONFIG_SBI_HSM_IDLE_GOVERNOR
+	/* Observed wake latency of each idle state in timer ticks */
+	u64 idle_latency[SBI_HSM_IDLE_STATE_MAX];
+	/* Idle state picked for the pending governed suspend, -1 if none */
+	int idle_state;
+	/* Time the governed suspend was entered and expected to end */
+	u64 idle_enter;
+	u64 idle_expected;
+#endif
 };
 
+static void hsm_interruptible_update(struct sbi_hsm_data *hdata,
+				     long newstate)
+{
+	unsigned long *bits = sbi_hartmask_bits(&hsm_interruptible_harts);
+
+	if (newstate == SBI_HSM_STATE_STARTED ||
+	    newstate == SBI_HSM_STATE_SUSPENDED)
+		atomic_raw_set_bit(hdata->hartindex, bits);
+	else
+		atomic_raw_clear_bit(hdata->hartindex, bits);
+}
+
 bool sbi_hsm_hart_change_state(struct sbi_scratch *scratch, long oldstate,
 			       long newstate)
 {
@@ -102,6 +140,20 @@ static void hsm_start_ticket_release(struct sbi_hsm_data *hdata)
 	atomic_write(&hdata->start_ticket, 0);
 }
 
+/* Get BITS_PER_LONG bits of a hartmask starting from the given bit */
+static ulong hsm_hartmask_window(const struct sbi_hartmask *m, ulong base)
+{
+	const unsigned long *bits = sbi_hartmask_bits(m);
+	ulong w = BIT_WORD(base), off = BIT_WORD_OFFSET(base), ret = 0;
+
+	if (w < BITS_TO_LONGS(SBI_HARTMASK_MAX_BITS))
+		ret = bits[w] >> off;
+	if (off && (w + 1) < BITS_TO_LONGS(SBI_HARTMASK_MAX_BITS))
+		ret |= bits[w + 1] << (BITS_PER_LONG - off);
+
+	return ret;
+}
+
 /**
  * Get ulong HART mask for given HART base ID
  * @param dom the domain to be used for output HART mask
@@ -113,28 +165,51 @@ static void hsm_start_ticket_release(struct sbi_hsm_data *hdata)
 int sbi_hsm_hart_interruptible_mask(const struct sbi_domain *dom,
 				    ulong hbase, ulong *out_hmask)
 {
-	int hstate;
-	ulong i, hmask, dmask;
+	ulong i, dmask;
 
 	*out_hmask = 0;
 	if (!sbi_hartid_valid(hbase))
 		return SBI_EINVAL;
 
+	/*
+	 * Both hartmasks are indexed by HART index so with an identity
+	 * HART id mapping the result is a plain AND of two windows.
+	 */
+	if (hsm_hartid_is_hartindex) {
+		*out_hmask = hsm_hartmask_window(&dom->assigned_harts, hbase) &
+			hsm_hartmask_window(&hsm_interruptible_harts, hbase);
+		return 0;
+	}
+
 	dmask = sbi_domain_get_assigned_hartmask(dom, hbase);
 	for (i = 0; i < BITS_PER_LONG; i++) {
-		hmask = 1UL << i;
-		if (!(dmask & hmask))
-			continue;
-
-		hstate = __sbi_hsm_hart_get_state(hbase + i);
-		if (hstate == SBI_HSM_STATE_STARTED ||
-		    hstate == SBI_HSM_STATE_SUSPENDED)
-			*out_hmask |= hmask;
+		if ((dmask & (1UL << i)) &&
+		    sbi_hartmask_test_hartid(hbase + i,
+					     &hsm_interruptible_harts))
+			*out_hmask |= 1UL << i;
 	}
 
 	return 0;
 }
 
+/* Account the time from a start request until entering the next stage */
+static void hsm_start_latency_update(struct sbi_hsm_data *hdata, u32 hartid)
+{
+	u64 latency;
+
+	if (!hdata->start_time)
+		return;
+
+	latency = sbi_timer_value() - hdata->start_time;
+	hdata->start_time = 0;
+	if (hdata->start_latency_max < latency)
+		hdata->start_latency_max = latency;
+
+	sbi_dprintf("%s: hart%u started in %lu ticks (max %lu ticks)\n",
+		    __func__, hartid, (unsigned long)latency,
+		    (unsigned long)hdata->start_latency_max);
+}
+
 void __noreturn sbi_hsm_hart_start_finish(struct sbi_scratch *scratch,
 					  u32 hartid)
 {
@@ -151,6 +226,7 @@ void __noreturn sbi_hsm_hart_start_finish(struct sbi_scratch *scratch,
 	next_arg1 = scratch->next_arg1;
 	next_addr = scratch->next_addr;
 	next_mode = scratch->next_mode;
+	hsm_start_latency_update(hdata, hartid);
 	hsm_start_ticket_release(hdata);
 
 	sbi_hart_switch_mode(hartid, next_arg1, next_addr, next_mode, false);
@@ -235,6 +311,98 @@ static void hsm_device_hart_resume(void)
 		hsm_dev->hart_resume();
 }
 
+#ifdef CONFIG_SBI_HSM_IDLE_GOVERNOR
+static u64 hsm_idle_us_to_ticks(u32 us)
+{
+	const struct sbi_timer_device *tdev = sbi_timer_get_device();
+
+	return tdev ? ((u64)us * tdev->timer_freq) / 1000000 : 0;
+}
+
+/*
+ * Pick the deepest idle state of the HSM device whose observed wake
+ * latency and minimum residency both fit the expected sleep duration.
+ * Without a fitting state fall back to retentive WFI.
+ */
+static u32 hsm_idle_select(struct sbi_hsm_data *hdata, u32 suspend_type,
+			   ulong exp_sleep)
+{
+	const struct sbi_hsm_idle_state *st;
+	u64 *latency;
+	int i;
+
+	hdata->idle_state = -1;
+	if (suspend_type != SBI_HSM_SUSPEND_GOVERNED)
+		return suspend_type;
+	if (!hsm_dev || !hsm_dev->idle_states || !sbi_timer_get_device())
+		return SBI_HSM_SUSPEND_RET_DEFAULT;
+
+	i = MIN(hsm_dev->idle_state_count, SBI_HSM_IDLE_STATE_MAX);
+	while (i--) {
+		st = &hsm_dev->idle_states[i];
+		latency = &hdata->idle_latency[i];
+
+		/* Start from the platform estimate until observed */
+		if (!*latency)
+			*latency = hsm_idle_us_to_ticks(st->latency_us);
+
+		if (*latency > exp_sleep ||
+		    hsm_idle_us_to_ticks(st->min_residency_us) > exp_sleep)
+			continue;
+
+		hdata->idle_state = i;
+		hdata->idle_enter = sbi_timer_value();
+		hdata->idle_expected = hdata->idle_enter + exp_sleep;
+		return st->suspend_type;
+	}
+
+	return SBI_HSM_SUSPEND_RET_DEFAULT;
+}
+
+/*
+ * Fold the wake latency of the pending governed suspend into the
+ * estimate of its idle state. When the HART wakes after the expected
+ * sleep the overshoot is the latency, when it wakes earlier the whole
+ * stay only bounds the latency from above.
+ */
+static void hsm_idle_account(struct sbi_hsm_data *hdata)
+{
+	u64 now, sample, *latency;
+
+	if (hdata->idle_state < 0)
+		return;
+
+	now = sbi_timer_value();
+	latency = &hdata->idle_latency[hdata->idle_state];
+	hdata->idle_state = -1;
+
+	if (now >= hdata->idle_expected) {
+		sample = now - hdata->idle_expected;
+	} else {
+		sample = now - hdata->idle_enter;
+		if (sample >= *latency)
+			return;
+	}
+
+	*latency = *latency - (*latency >> 3) + (sample >> 3);
+}
+
+static void hsm_idle_cancel(struct sbi_hsm_data *hdata)
+{
+	hdata->idle_state = -1;
+}
+#else
+static u32 hsm_idle_select(struct sbi_hsm_data *hdata, u32 suspend_type,
+			   ulong exp_sleep)
+{
+	return suspend_type;
+}
+
+static void hsm_idle_account(struct sbi_hsm_data *hdata) { }
+
+static void hsm_idle_cancel(struct sbi_hsm_data *hdata) { }
+#endif
+
 int sbi_hsm_init(struct sbi_scratch *scratch, u32 hartid, bool cold_boot)
 {
 	u32 i;
@@ -242,7 +410,8 @@ int sbi_hsm_init(struct sbi_scratch *scratch, u32 hartid, bool cold_boot)
 	struct sbi_hsm_data *hdata;
 
 	if (cold_boot) {
-		hart_data_offset = sbi_scratch_alloc_offset(sizeof(*hdata));
+		hart_data_offset = sbi_scratch_alloc_class_offset(sizeof(*hdata),
+					SBI_SCRATCH_ALLOC_REMOTE_WRITTEN);
 		if (!hart_data_offset)
 			return SBI_ENOMEM;
 
@@ -259,6 +428,16 @@ int sbi_hsm_init(struct sbi_scratch *scratch, u32 hartid, bool cold_boot)
 				    SBI_HSM_STATE_START_PENDING :
 				    SBI_HSM_STATE_STOPPED);
 			ATOMIC_INIT(&hdata->start_ticket, 0);
+			hdata->hartindex = i;
+#ifdef CONFIG_SBI_HSM_IDLE_GOVERNOR
+			hdata->idle_state = -1;
+#endif
+		}
+
+		hsm_hartid_is_hartindex = true;
+		for (i = 0; i <= sbi_scratch_last_hartindex(); i++) {
+			if (sbi_hartindex_to_hartid(i) != i)
+				hsm_hartid_is_hartindex = false;
 		}
 	} else {
 		sbi_hsm_hart_wait(scratch, hartid);
@@ -328,6 +507,7 @@ int sbi_hsm_hart_start(struct sbi_scratch *scratch,
 	rscratch->next_arg1 = arg1;
 	rscratch->next_addr = saddr;
 	rscratch->next_mode = smode;
+	hdata->start_time = sbi_timer_value();
 
 	/*
 	 * atomic_cmpxchg() is an implicit barrier. It makes sure that
@@ -360,6 +540,7 @@ int sbi_hsm_hart_start(struct sbi_scratch *scratch,
 	if (!rc)
 		return 0;
 err:
+	hdata->start_time = 0;
 	hsm_start_ticket_release(hdata);
 	return rc;
 }
@@ -447,6 +628,8 @@ void __noreturn sbi_hsm_hart_resume_finish(struct sbi_scratch *scratch,
 					 SBI_HSM_STATE_STARTED))
 		sbi_hart_hang();
 
+	hsm_idle_account(hdata);
+
 	/*
 	 * Restore some of the M-mode CSRs which we are re-configured by
 	 * the warm-boot sequence.
@@ -459,9 +642,10 @@ void __noreturn sbi_hsm_hart_resume_finish(struct sbi_scratch *scratch,
 }
 
 int sbi_hsm_hart_suspend(struct sbi_scratch *scratch, u32 suspend_type,
-			 ulong raddr, ulong rmode, ulong arg1)
+			 ulong raddr, ulong rmode, ulong arg1, ulong exp_sleep)
 {
 	int ret;
+	u32 idle_type;
 	const struct sbi_domain *dom = sbi_domain_thishart_ptr();
 	struct sbi_hsm_data *hdata = sbi_scratch_offset_ptr(scratch,
 							    hart_data_offset);
@@ -511,12 +695,19 @@ int sbi_hsm_hart_suspend(struct sbi_scratch *scratch, u32 suspend_type,
 	if (suspend_type & SBI_HSM_SUSP_NON_RET_BIT)
 		__sbi_hsm_suspend_non_ret_save(scratch);
 
+	/*
+	 * The idle state actually entered may differ from the requested
+	 * suspend type when the firmware idle governor picks it, but the
+	 * resume still follows the requested suspend type.
+	 */
+	idle_type = hsm_idle_select(hdata, suspend_type, exp_sleep);
+
 	/* Try platform specific suspend */
-	ret = hsm_device_hart_suspend(suspend_type);
+	ret = hsm_device_hart_suspend(idle_type);
 	if (ret == SBI_ENOTSUPP) {
 		/* Try generic implementation of default suspend types */
-		if (suspend_type == SBI_HSM_SUSPEND_RET_DEFAULT ||
-		    suspend_type == SBI_HSM_SUSPEND_NON_RET_DEFAULT) {
+		if (idle_type == SBI_HSM_SUSPEND_RET_DEFAULT ||
+		    idle_type == SBI_HSM_SUSPEND_NON_RET_DEFAULT) {
 			ret = __sbi_hsm_suspend_default(scratch);
 		}
 	}
@@ -538,6 +729,7 @@ int sbi_hsm_hart_suspend(struct sbi_scratch *scratch, u32 suspend_type,
 	 * We might have successfully resumed from retentive suspend
 	 * or suspend failed. In both cases, we restore state of hart.
 	 */
+	hsm_idle_cancel(hdata);
 	if (!__sbi_hsm_hart_change_state(hdata, SBI_HSM_STATE_SUSPENDED,
 					 SBI_HSM_STATE_STARTED))
 		sbi_hart_hang();
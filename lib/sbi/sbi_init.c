@@ -152,6 +152,7 @@ static void sbi_boot_print_domains(struct sbi_scratch *scratch)
 static void sbi_boot_print_hart(struct sbi_scratch *scratch, u32 hartid)
 {
 	int xlen;
+	unsigned int pmp_used, pmp_saved;
 	char str[128];
 	const struct sbi_domain *dom = sbi_domain_thishart_ptr();
 
@@ -180,6 +181,9 @@ static void sbi_boot_print_hart(struct sbi_scratch *scratch, u32 hartid)
 		   sbi_hart_pmp_granularity(scratch));
 	sbi_printf("Boot HART PMP Address Bits: %d\n",
 		   sbi_hart_pmp_addrbits(scratch));
+	pmp_used = sbi_hart_pmp_used(scratch, &pmp_saved);
+	sbi_printf("Boot HART PMP Used        : %u (%u saved)\n",
+		   pmp_used, pmp_saved);
 	sbi_printf("Boot HART MHPM Info       : %lu (0x%08x)\n",
 		   sbi_popcount(sbi_hart_mhpm_mask(scratch)),
 		   sbi_hart_mhpm_mask(scratch));
@@ -636,6 +640,8 @@ void __noreturn sbi_exit(struct sbi_scratch *scratch)
 
 	sbi_platform_early_exit(plat);
 
+	sbi_console_flush();
+
 	sbi_pmu_exit(scratch);
 
 	sbi_timer_exit(scratch);
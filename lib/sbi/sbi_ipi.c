@@ -219,7 +219,8 @@ void sbi_ipi_process(void)
 	struct sbi_scratch *scratch = sbi_scratch_thishart_ptr();
 	struct sbi_ipi_data *ipi_data =
 			sbi_scratch_offset_ptr(scratch, ipi_data_off);
-	u32 hartindex = sbi_hartid_to_hartindex(current_hartid());
+	u32 hartindex = current_hartindex();
+	unsigned long cycles = sbi_pmu_fw_cycles_begin();
 
 	sbi_pmu_ctr_incr_fw(SBI_PMU_FW_IPI_RECVD);
 	if (ipi_dev && ipi_dev->ipi_clear)
@@ -236,6 +237,8 @@ void sbi_ipi_process(void)
 		ipi_type = ipi_type >> 1;
 		ipi_event++;
 	}
+
+	sbi_pmu_fw_cycles_end(SBI_PMU_FW_CYCLES_IPI, cycles);
 }
 
 int sbi_ipi_raw_send(u32 hartindex)
@@ -272,7 +275,8 @@ int sbi_ipi_init(struct sbi_scratch *scratch, bool cold_boot)
 	struct sbi_ipi_data *ipi_data;
 
 	if (cold_boot) {
-		ipi_data_off = sbi_scratch_alloc_offset(sizeof(*ipi_data));
+		ipi_data_off = sbi_scratch_alloc_class_offset(sizeof(*ipi_data),
+					SBI_SCRATCH_ALLOC_REMOTE_WRITTEN);
 		if (!ipi_data_off)
 			return SBI_ENOMEM;
 		ret = sbi_ipi_event_create(&ipi_smode_ops);
@@ -7,8 +7,25 @@
  *   Anup Patel <apatel@ventanamicro.com>
  */
 
+#include <sbi/sbi_console.h>
+#include <sbi/sbi_error.h>
 #include <sbi/sbi_irqchip.h>
 #include <sbi/sbi_platform.h>
+#include <sbi/sbi_scratch.h>
+
+struct sbi_irqchip_hwirq_handler {
+	u32 hwirq;
+	unsigned long parent_addr;
+	int (*fn)(u32 hwirq, void *priv);
+	void (*routed)(u32 hwirq, void *priv);
+	void *priv;
+};
+
+static const struct sbi_irqchip_device *irqchip_dev = NULL;
+static struct sbi_irqchip_hwirq_handler
+	hwirq_handlers[SBI_IRQCHIP_MAX_HWIRQ_HANDLERS];
+static u32 hwirq_handler_count;
+static u32 hwirq_owner_hartindex = -1U;
 
 static int default_irqfn(struct sbi_trap_regs *regs)
 {
@@ -28,6 +45,108 @@ int sbi_irqchip_process(struct sbi_trap_regs *regs)
 	return ext_irqfn(regs);
 }
 
+static int hwirq_irqfn(struct sbi_trap_regs *regs)
+{
+	u32 i, hwirq;
+
+	while ((hwirq = irqchip_dev->hwirq_claim())) {
+		for (i = 0; i < hwirq_handler_count; i++) {
+			if (hwirq_handlers[i].hwirq == hwirq) {
+				hwirq_handlers[i].fn(hwirq,
+						     hwirq_handlers[i].priv);
+				break;
+			}
+		}
+		irqchip_dev->hwirq_complete(hwirq);
+	}
+
+	return 0;
+}
+
+static void hwirq_handlers_route(bool cold_boot)
+{
+	struct sbi_irqchip_hwirq_handler *h;
+	u32 i;
+	int rc;
+
+	if (!hwirq_handler_count || !irqchip_dev)
+		return;
+
+	/*
+	 * Wired interrupts are taken by a single HART so that they don't
+	 * wake up every HART. The cold boot HART owns them and routes them
+	 * again whenever it goes through the warm boot path.
+	 */
+	if (cold_boot) {
+		if (ext_irqfn != default_irqfn) {
+			sbi_printf("%s: %s can't route wired interrupts to "
+				   "M-mode\n", __func__, irqchip_dev->name);
+			return;
+		}
+		ext_irqfn = hwirq_irqfn;
+		hwirq_owner_hartindex = current_hartindex();
+	} else if (hwirq_owner_hartindex != current_hartindex()) {
+		return;
+	}
+
+	/*
+	 * A wired interrupt which can't be routed is simply polled and its
+	 * source is never enabled.
+	 */
+	for (i = 0; i < hwirq_handler_count; i++) {
+		h = &hwirq_handlers[i];
+		rc = irqchip_dev->hwirq_route(h->parent_addr, h->hwirq, true);
+		if (rc) {
+			sbi_printf("%s: failed to route hwirq %u (error %d)\n",
+				   __func__, h->hwirq, rc);
+			continue;
+		}
+		if (h->routed)
+			h->routed(h->hwirq, h->priv);
+	}
+}
+
+const struct sbi_irqchip_device *sbi_irqchip_get_device(void)
+{
+	return irqchip_dev;
+}
+
+void sbi_irqchip_set_device(const struct sbi_irqchip_device *dev)
+{
+	if (!dev || irqchip_dev)
+		return;
+
+	irqchip_dev = dev;
+}
+
+int sbi_irqchip_register_hwirq_handler(u32 hwirq, unsigned long parent_addr,
+				       int (*fn)(u32 hwirq, void *priv),
+				       void (*routed)(u32 hwirq, void *priv),
+				       void *priv)
+{
+	u32 i;
+
+	if (!hwirq || !fn)
+		return SBI_EINVAL;
+
+	for (i = 0; i < hwirq_handler_count; i++) {
+		if (hwirq_handlers[i].hwirq == hwirq)
+			return SBI_EALREADY;
+	}
+
+	if (hwirq_handler_count >= SBI_IRQCHIP_MAX_HWIRQ_HANDLERS)
+		return SBI_ENOSPC;
+
+	hwirq_handlers[hwirq_handler_count].hwirq = hwirq;
+	hwirq_handlers[hwirq_handler_count].parent_addr = parent_addr;
+	hwirq_handlers[hwirq_handler_count].fn = fn;
+	hwirq_handlers[hwirq_handler_count].routed = routed;
+	hwirq_handlers[hwirq_handler_count].priv = priv;
+	hwirq_handler_count++;
+
+	return 0;
+}
+
 int sbi_irqchip_init(struct sbi_scratch *scratch, bool cold_boot)
 {
 	int rc;
@@ -37,6 +156,8 @@ int sbi_irqchip_init(struct sbi_scratch *scratch, bool cold_boot)
 	if (rc)
 		return rc;
 
+	hwirq_handlers_route(cold_boot);
+
 	if (ext_irqfn != default_irqfn)
 		csr_set(CSR_MIE, MIP_MEIP);
 
@@ -10,13 +10,16 @@
 #include <sbi/riscv_asm.h>
 #include <sbi/sbi_bitops.h>
 #include <sbi/sbi_console.h>
+#include <sbi/sbi_domain.h>
 #include <sbi/sbi_ecall_interface.h>
+#include <sbi/sbi_error.h>
 #include <sbi/sbi_hart.h>
 #include <sbi/sbi_heap.h>
 #include <sbi/sbi_platform.h>
 #include <sbi/sbi_pmu.h>
 #include <sbi/sbi_scratch.h>
 #include <sbi/sbi_string.h>
+#include <sbi/sbi_timer.h>
 
 /** Information about hardware counters */
 struct sbi_pmu_hw_event {
@@ -54,38 +57,102 @@ union sbi_pmu_ctr_info {
 #error "Can't handle firmware counters beyond BITS_PER_LONG"
 #endif
 
+/** Layout of the counter snapshot shared memory as per SBI specification */
+struct sbi_pmu_snapshot {
+	/* Bitmap of overflown counters relative to counter_idx_base */
+	uint64_t ctr_overflow_mask;
+	/* Counter values relative to counter_idx_base */
+	uint64_t ctr_values[64];
+	uint64_t reserved[447];
+};
+
+_Static_assert(sizeof(struct sbi_pmu_snapshot) == SBI_PMU_SNAPSHOT_SIZE,
+	       "struct sbi_pmu_snapshot must match SBI_PMU_SNAPSHOT_SIZE");
+
+#ifdef CONFIG_SBI_PMU_MUX
+/** State of a logical counter multiplexed over the hardware counters */
+struct sbi_pmu_mux_ctr {
+	/* Event data and config flags passed to cfg_match */
+	uint64_t event_data;
+	unsigned long cfg_flags;
+	/* Initial value set by supervisor software */
+	uint64_t base;
+	/* Events counted while scheduled on a hardware counter */
+	uint64_t count;
+	/* Timer ticks while started and while scheduled */
+	uint64_t enabled;
+	uint64_t running;
+	/* Timer value of the last update */
+	uint64_t last;
+	/* Hardware counter value at the last update */
+	uint64_t hw_last;
+	/* Hardware counter currently used or -1 */
+	int hw_ctr;
+};
+#endif
+
 /** Per-HART state of the PMU counters */
 struct sbi_pmu_hart_state {
 	/* HART to which this state belongs */
 	uint32_t hartid;
 	/* Counter to enabled event mapping */
-	uint32_t active_events[SBI_PMU_HW_CTR_MAX + SBI_PMU_FW_CTR_MAX];
+	uint32_t active_events[SBI_PMU_CTR_MAX];
 	/* Bitmap of firmware counters started */
 	unsigned long fw_counters_started;
+	/*
+	 * Bitmap of started firmware counters for each SBI firmware event
+	 * followed by the OpenSBI specific firmware cycles and count events
+	 */
+	unsigned long fw_event_counters[SBI_PMU_FW_MAX +
+					SBI_PMU_FW_CYCLES_COUNT +
+					SBI_PMU_FW_COUNT_COUNT];
 	/*
 	 * Counter values for SBI firmware events and event codes
 	 * for platform firmware events. Both are mutually exclusive
 	 * and hence can optimally share the same memory.
 	 */
 	uint64_t fw_counters_data[SBI_PMU_FW_CTR_MAX];
+	/* Physical address of the counter snapshot shared memory */
+	unsigned long snapshot_addr;
+	/* Whether the counter snapshot shared memory is registered */
+	bool snapshot_enabled;
+	/* Bitmap of hardware counters delegated to S-mode */
+	unsigned long hw_ctr_delegated;
+#ifdef CONFIG_SBI_PMU_MUX
+	/* Multiplexed counters placed after the firmware counters */
+	struct sbi_pmu_mux_ctr mux_ctrs[SBI_PMU_MUX_CTR_MAX];
+	/* Bitmap of multiplexed counters started */
+	unsigned long mux_started;
+	/* Bitmap of hardware counters used by multiplexed counters */
+	unsigned long mux_hw_mask;
+	/* Multiplexed counter scheduled first on next rotation */
+	uint32_t mux_next;
+	/* Timer value of the last rotation */
+	uint64_t mux_last_rotate;
+	/* Firmware timer event rotating the multiplexed counters */
+	struct sbi_timer_event mux_timer;
+#endif
 };
 
-/** Offset of pointer to PMU HART state in scratch space */
-static unsigned long phs_ptr_offset;
-
+/* PMU HART state pointer lives in the hot context of sbi_scratch */
 #define pmu_get_hart_state_ptr(__scratch)				\
-	sbi_scratch_read_type((__scratch), void *, phs_ptr_offset)
+	((struct sbi_pmu_hart_state *)(__scratch)->hot.pmu_state)
 
 #define pmu_thishart_state_ptr()					\
 	pmu_get_hart_state_ptr(sbi_scratch_thishart_ptr())
 
 #define pmu_set_hart_state_ptr(__scratch, __phs)			\
-	sbi_scratch_write_type((__scratch), void *, phs_ptr_offset, (__phs))
+	((__scratch)->hot.pmu_state = (__phs))
 
 /* Platform specific PMU device */
 static const struct sbi_pmu_device *pmu_dev = NULL;
 
-/* Mapping between event range and possible counters  */
+/*
+ * Mapping between event range and possible counters sorted by
+ * (start_idx, select_mask, select). The event ranges don't overlap
+ * so the non-raw events can be looked up with a binary search. The
+ * raw events come last and are grouped by select_mask.
+ */
 static struct sbi_pmu_hw_event *hw_event_map;
 
 /* Maximum number of hardware events available */
@@ -101,6 +168,31 @@ static uint32_t total_ctrs;
   (((x) & SBI_PMU_EVENT_IDX_TYPE_MASK) >> SBI_PMU_EVENT_IDX_TYPE_OFFSET)
 #define get_cidx_code(x) (x & SBI_PMU_EVENT_IDX_CODE_MASK)
 
+/* Index of the first multiplexed counter */
+#define pmu_mux_ctr_base() (num_hw_ctrs + SBI_PMU_FW_CTR_MAX)
+
+static inline bool pmu_ctr_is_mux(uint32_t cidx)
+{
+	return pmu_mux_ctr_base() <= cidx && cidx < total_ctrs;
+}
+
+#ifdef CONFIG_SBI_PMU_MUX
+#define pmu_mux_hw_mask(__phs) ((__phs)->mux_hw_mask)
+
+static int pmu_mux_ctr_start(struct sbi_pmu_hart_state *phs, uint32_t cidx,
+			     uint64_t ival, bool ival_update);
+static int pmu_mux_ctr_stop(struct sbi_pmu_hart_state *phs, uint32_t cidx);
+static int pmu_mux_ctr_read(struct sbi_pmu_hart_state *phs, uint32_t cidx,
+			    uint64_t *cval);
+#else
+#define pmu_mux_hw_mask(__phs) 0UL
+
+/* Never called because there are no multiplexed counters */
+#define pmu_mux_ctr_start(__phs, __cidx, __ival, __ival_update) SBI_EINVAL
+#define pmu_mux_ctr_stop(__phs, __cidx)				SBI_EINVAL
+#define pmu_mux_ctr_read(__phs, __cidx, __cval)			SBI_EINVAL
+#endif
+
 /**
  * Perform a sanity check on event & counter mappings with event range overlap check
  * @param evtA Pointer to the existing hw event structure
@@ -127,6 +219,37 @@ static bool pmu_event_select_overlap(struct sbi_pmu_hw_event *evt,
 	return false;
 }
 
+static bool pmu_fw_event_code_valid(uint32_t event_code)
+{
+	return event_code < SBI_PMU_FW_MAX ||
+	       (SBI_PMU_FW_CYCLES_BASE <= event_code &&
+		event_code < SBI_PMU_FW_CYCLES_MAX) ||
+	       (SBI_PMU_FW_COUNT_BASE <= event_code &&
+		event_code < SBI_PMU_FW_COUNT_MAX) ||
+	       event_code == SBI_PMU_FW_PLATFORM;
+}
+
+/**
+ * Get the slot of a firmware event in fw_event_counters
+ * @param event_code the firmware event code
+ *
+ * Return slot index or negative value if the event is not counted
+ * by OpenSBI itself (i.e. platform firmware events)
+ */
+static int pmu_fw_event_slot(uint32_t event_code)
+{
+	if (event_code < SBI_PMU_FW_MAX)
+		return event_code;
+	if (SBI_PMU_FW_CYCLES_BASE <= event_code &&
+	    event_code < SBI_PMU_FW_CYCLES_MAX)
+		return SBI_PMU_FW_MAX + event_code - SBI_PMU_FW_CYCLES_BASE;
+	if (SBI_PMU_FW_COUNT_BASE <= event_code &&
+	    event_code < SBI_PMU_FW_COUNT_MAX)
+		return SBI_PMU_FW_MAX + SBI_PMU_FW_CYCLES_COUNT +
+		       event_code - SBI_PMU_FW_COUNT_BASE;
+	return -1;
+}
+
 static int pmu_event_validate(struct sbi_pmu_hart_state *phs,
 			      unsigned long event_idx, uint64_t edata)
 {
@@ -140,18 +263,17 @@ static int pmu_event_validate(struct sbi_pmu_hart_state *phs,
 		event_idx_code_max = SBI_PMU_HW_GENERAL_MAX;
 		break;
 	case SBI_PMU_EVENT_TYPE_FW:
-		if ((event_idx_code >= SBI_PMU_FW_MAX &&
-		    event_idx_code <= SBI_PMU_FW_RESERVED_MAX) ||
-		    event_idx_code > SBI_PMU_FW_PLATFORM)
+		if (!pmu_fw_event_code_valid(event_idx_code))
 			return SBI_EINVAL;
 
-		if (SBI_PMU_FW_PLATFORM == event_idx_code &&
-		    pmu_dev && pmu_dev->fw_event_validate_encoding)
-			return pmu_dev->fw_event_validate_encoding(phs->hartid,
-							           edata);
-		else
-			event_idx_code_max = SBI_PMU_FW_MAX;
-		break;
+		if (SBI_PMU_FW_PLATFORM == event_idx_code) {
+			if (pmu_dev && pmu_dev->fw_event_validate_encoding)
+				return pmu_dev->fw_event_validate_encoding(
+							phs->hartid, edata);
+			return SBI_EINVAL;
+		}
+
+		return event_idx_type;
 	case SBI_PMU_EVENT_TYPE_HW_CACHE:
 		cache_ops_result = event_idx_code &
 					SBI_PMU_EVENT_HW_CACHE_OPS_RESULT;
@@ -190,6 +312,10 @@ static int pmu_ctr_validate(struct sbi_pmu_hart_state *phs,
 	if (cidx >= total_ctrs)
 		return SBI_EINVAL;
 
+	/* Delegated counters are owned by S-mode */
+	if (cidx < num_hw_ctrs && (phs->hw_ctr_delegated & BIT(cidx)))
+		return SBI_EINVAL;
+
 	event_idx_val = phs->active_events[cidx];
 	event_idx_type = get_cidx_type(event_idx_val);
 	if (event_idx_val == SBI_PMU_EVENT_IDX_INVALID ||
@@ -207,13 +333,14 @@ int sbi_pmu_ctr_fw_read(uint32_t cidx, uint64_t *cval)
 	uint32_t event_code;
 	struct sbi_pmu_hart_state *phs = pmu_thishart_state_ptr();
 
+	if (pmu_ctr_is_mux(cidx))
+		return pmu_mux_ctr_read(phs, cidx, cval);
+
 	event_idx_type = pmu_ctr_validate(phs, cidx, &event_code);
 	if (event_idx_type != SBI_PMU_EVENT_TYPE_FW)
 		return SBI_EINVAL;
 
-	if ((event_code >= SBI_PMU_FW_MAX &&
-	    event_code <= SBI_PMU_FW_RESERVED_MAX) ||
-	    event_code > SBI_PMU_FW_PLATFORM)
+	if (!pmu_fw_event_code_valid(event_code))
 		return SBI_EINVAL;
 
 	if (SBI_PMU_FW_PLATFORM == event_code) {
@@ -229,12 +356,110 @@ int sbi_pmu_ctr_fw_read(uint32_t cidx, uint64_t *cval)
 	return 0;
 }
 
+static int pmu_hw_event_cmp(const struct sbi_pmu_hw_event *evt,
+			    uint32_t start_idx, uint64_t select_mask,
+			    uint64_t select)
+{
+	if (evt->start_idx != start_idx)
+		return (evt->start_idx < start_idx) ? -1 : 1;
+	if (evt->select_mask != select_mask)
+		return (evt->select_mask < select_mask) ? -1 : 1;
+	if (evt->select != select)
+		return (evt->select < select) ? -1 : 1;
+	return 0;
+}
+
+/* Index of the first event in [lo, hi) which is not sorted before the key */
+static uint32_t pmu_hw_event_lower_bound(uint32_t lo, uint32_t hi,
+					 uint32_t start_idx,
+					 uint64_t select_mask, uint64_t select)
+{
+	uint32_t mid;
+
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		if (pmu_hw_event_cmp(&hw_event_map[mid], start_idx,
+				     select_mask, select) < 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return lo;
+}
+
+/**
+ * Find the hardware event map entry matching an event
+ * @param event_idx the event index
+ * @param data the event data used as select value for raw events
+ * @param prev the previously returned entry or NULL for the first lookup
+ *
+ * Return the next matching entry or NULL if there is none
+ */
+static struct sbi_pmu_hw_event *pmu_hw_event_find(unsigned long event_idx,
+						  uint64_t data,
+						  struct sbi_pmu_hw_event *prev)
+{
+	struct sbi_pmu_hw_event *evt;
+	uint64_t mask;
+	uint32_t i, j;
+
+	if (event_idx != SBI_PMU_EVENT_RAW_IDX) {
+		/* Only one range can contain the event */
+		if (prev)
+			return NULL;
+		i = pmu_hw_event_lower_bound(0, num_hw_events,
+					     event_idx + 1, 0, 0);
+		if (!i)
+			return NULL;
+		evt = &hw_event_map[i - 1];
+		if (evt->start_idx <= event_idx && event_idx <= evt->end_idx)
+			return evt;
+		return NULL;
+	}
+
+	/*
+	 * Raw events match when the select value equals the masked event
+	 * data so search each group of raw events sharing a select_mask.
+	 */
+	if (prev) {
+		if (prev->select_mask == ~0ULL)
+			return NULL;
+		i = pmu_hw_event_lower_bound(prev - hw_event_map, num_hw_events,
+					     SBI_PMU_EVENT_RAW_IDX,
+					     prev->select_mask + 1, 0);
+	} else {
+		i = pmu_hw_event_lower_bound(0, num_hw_events,
+					     SBI_PMU_EVENT_RAW_IDX, 0, 0);
+	}
+
+	while (i < num_hw_events) {
+		mask = hw_event_map[i].select_mask;
+		j = pmu_hw_event_lower_bound(i, num_hw_events,
+					     SBI_PMU_EVENT_RAW_IDX,
+					     mask, data & mask);
+		if (j < num_hw_events &&
+		    !pmu_hw_event_cmp(&hw_event_map[j], SBI_PMU_EVENT_RAW_IDX,
+				      mask, data & mask))
+			return &hw_event_map[j];
+		if (mask == ~0ULL)
+			break;
+		i = pmu_hw_event_lower_bound(j, num_hw_events,
+					     SBI_PMU_EVENT_RAW_IDX,
+					     mask + 1, 0);
+	}
+
+	return NULL;
+}
+
 static int pmu_add_hw_event_map(u32 eidx_start, u32 eidx_end, u32 cmap,
 				uint64_t select, uint64_t select_mask)
 {
 	int i = 0;
 	bool is_overlap;
-	struct sbi_pmu_hw_event *event = &hw_event_map[num_hw_events];
+	uint32_t pos;
+	struct sbi_pmu_hw_event new_event = { 0 };
+	struct sbi_pmu_hw_event *event = &new_event;
 	struct sbi_scratch *scratch = sbi_scratch_thishart_ptr();
 	uint32_t ctr_avail_mask = sbi_hart_mhpm_mask(scratch) | 0x7;
 
@@ -260,21 +485,23 @@ static int pmu_add_hw_event_map(u32 eidx_start, u32 eidx_end, u32 cmap,
 		else
 			is_overlap = pmu_event_range_overlap(&hw_event_map[i], event);
 		if (is_overlap)
-			goto reset_event;
+			return SBI_EINVAL;
 	}
 
 	event->select_mask = select_mask;
 	/* Map the only the counters that are available in the hardware */
 	event->counters = cmap & ctr_avail_mask;
 	event->select = select;
+
+	/* Keep the event map sorted for pmu_hw_event_find() */
+	pos = pmu_hw_event_lower_bound(0, num_hw_events, event->start_idx,
+				       event->select_mask, event->select);
+	for (i = num_hw_events; i > pos; i--)
+		hw_event_map[i] = hw_event_map[i - 1];
+	hw_event_map[pos] = *event;
 	num_hw_events++;
 
 	return 0;
-
-reset_event:
-	event->start_idx = 0;
-	event->end_idx = 0;
-	return SBI_EINVAL;
 }
 
 /**
@@ -344,6 +571,57 @@ static void pmu_ctr_write_hw(uint32_t cidx, uint64_t ival)
 #endif
 }
 
+static uint64_t pmu_ctr_read_hw(uint32_t cidx)
+{
+#if __riscv_xlen == 32
+	uint32_t lo, hi, tmp;
+
+	do {
+		hi = csr_read_num(CSR_MCYCLEH + cidx);
+		lo = csr_read_num(CSR_MCYCLE + cidx);
+		tmp = csr_read_num(CSR_MCYCLEH + cidx);
+	} while (hi != tmp);
+
+	return ((uint64_t)hi << 32) | lo;
+#else
+	return csr_read_num(CSR_MCYCLE + cidx);
+#endif
+}
+
+static bool pmu_ctr_overflown_hw(uint32_t cidx)
+{
+	struct sbi_scratch *scratch = sbi_scratch_thishart_ptr();
+
+	if (cidx < 3 || cidx >= SBI_PMU_HW_CTR_MAX ||
+	    !sbi_hart_has_extension(scratch, SBI_HART_EXT_SSCOFPMF))
+		return false;
+
+#if __riscv_xlen == 32
+	return (csr_read_num(CSR_MHPMEVENT3H + cidx - 3) & MHPMEVENTH_OF) ?
+		true : false;
+#else
+	return (csr_read_num(CSR_MHPMEVENT3 + cidx - 3) & MHPMEVENT_OF) ?
+		true : false;
+#endif
+}
+
+static struct sbi_pmu_snapshot *pmu_snapshot_map(struct sbi_pmu_hart_state *phs)
+{
+	if (!phs->snapshot_enabled)
+		return NULL;
+
+	if (sbi_hart_map_registered_saddr(phs->snapshot_addr,
+					  SBI_PMU_SNAPSHOT_SIZE))
+		return NULL;
+
+	return (struct sbi_pmu_snapshot *)phs->snapshot_addr;
+}
+
+static void pmu_snapshot_unmap(void)
+{
+	sbi_hart_unmap_saddr();
+}
+
 static int pmu_ctr_start_hw(uint32_t cidx, uint64_t ival, bool ival_update)
 {
 	struct sbi_scratch *scratch = sbi_scratch_thishart_ptr();
@@ -393,14 +671,49 @@ int sbi_pmu_irq_bit(void)
 	return 0;
 }
 
+static void pmu_fw_counter_set_started(struct sbi_pmu_hart_state *phs,
+				       uint32_t cidx, uint32_t event_code)
+{
+	uint32_t fw_cidx = cidx - num_hw_ctrs;
+	int slot = pmu_fw_event_slot(event_code);
+
+	phs->fw_counters_started |= BIT(fw_cidx);
+	if (slot >= 0)
+		phs->fw_event_counters[slot] |= BIT(fw_cidx);
+}
+
+static void pmu_fw_counter_clear_started(struct sbi_pmu_hart_state *phs,
+					 uint32_t cidx, uint32_t event_code)
+{
+	uint32_t fw_cidx = cidx - num_hw_ctrs;
+	int slot = pmu_fw_event_slot(event_code);
+
+	phs->fw_counters_started &= ~BIT(fw_cidx);
+	if (slot >= 0)
+		phs->fw_event_counters[slot] &= ~BIT(fw_cidx);
+}
+
+unsigned long sbi_pmu_hw_ctr_delegated_mask(struct sbi_scratch *scratch)
+{
+#ifdef CONFIG_SBI_PMU_COUNTER_DELEGATION
+	if (!sbi_hart_has_extension(scratch, SBI_HART_EXT_SMCDELEG) ||
+	    !sbi_hart_has_extension(scratch, SBI_HART_EXT_SSCCFG))
+		return 0;
+
+	/* The TM bit is never delegated because time is not a counter */
+	return (sbi_hart_mhpm_mask(scratch) | SBI_PMU_FIXED_CTR_MASK) &
+		~BIT(CSR_TIME - CSR_CYCLE);
+#else
+	return 0;
+#endif
+}
+
 static int pmu_ctr_start_fw(struct sbi_pmu_hart_state *phs,
 			    uint32_t cidx, uint32_t event_code,
 			    uint64_t event_data, uint64_t ival,
 			    bool ival_update)
 {
-	if ((event_code >= SBI_PMU_FW_MAX &&
-	    event_code <= SBI_PMU_FW_RESERVED_MAX) ||
-	    event_code > SBI_PMU_FW_PLATFORM)
+	if (!pmu_fw_event_code_valid(event_code))
 		return SBI_EINVAL;
 
 	if (SBI_PMU_FW_PLATFORM == event_code) {
@@ -423,7 +736,7 @@ static int pmu_ctr_start_fw(struct sbi_pmu_hart_state *phs,
 			phs->fw_counters_data[cidx - num_hw_ctrs] = ival;
 	}
 
-	phs->fw_counters_started |= BIT(cidx - num_hw_ctrs);
+	pmu_fw_counter_set_started(phs, cidx, event_code);
 
 	return 0;
 }
@@ -432,6 +745,7 @@ int sbi_pmu_ctr_start(unsigned long cbase, unsigned long cmask,
 		      unsigned long flags, uint64_t ival)
 {
 	struct sbi_pmu_hart_state *phs = pmu_thishart_state_ptr();
+	struct sbi_pmu_snapshot *snapshot = NULL;
 	int event_idx_type;
 	uint32_t event_code;
 	int ret = SBI_EINVAL;
@@ -445,12 +759,26 @@ int sbi_pmu_ctr_start(unsigned long cbase, unsigned long cmask,
 	if (flags & SBI_PMU_START_FLAG_SET_INIT_VALUE)
 		bUpdate = true;
 
+	if (flags & SBI_PMU_START_FLAG_INIT_SNAPSHOT) {
+		snapshot = pmu_snapshot_map(phs);
+		if (!snapshot)
+			return SBI_ENO_SHMEM;
+		bUpdate = true;
+	}
+
 	for_each_set_bit(i, &cmask, total_ctrs) {
 		cidx = i + cbase;
 		event_idx_type = pmu_ctr_validate(phs, cidx, &event_code);
 		if (event_idx_type < 0)
 			/* Continue the start operation for other counters */
 			continue;
+
+		/* Initial values come from the snapshot when requested */
+		if (snapshot)
+			ival = snapshot->ctr_values[i];
+
+		if (pmu_ctr_is_mux(cidx))
+			ret = pmu_mux_ctr_start(phs, cidx, ival, bUpdate);
 		else if (event_idx_type == SBI_PMU_EVENT_TYPE_FW) {
 			edata = (event_code == SBI_PMU_FW_PLATFORM) ?
 				 phs->fw_counters_data[cidx - num_hw_ctrs]
@@ -462,6 +790,9 @@ int sbi_pmu_ctr_start(unsigned long cbase, unsigned long cmask,
 			ret = pmu_ctr_start_hw(cidx, ival, bUpdate);
 	}
 
+	if (snapshot)
+		pmu_snapshot_unmap();
+
 	return ret;
 }
 
@@ -495,9 +826,7 @@ static int pmu_ctr_stop_fw(struct sbi_pmu_hart_state *phs,
 {
 	int ret;
 
-	if ((event_code >= SBI_PMU_FW_MAX &&
-	    event_code <= SBI_PMU_FW_RESERVED_MAX) ||
-	    event_code > SBI_PMU_FW_PLATFORM)
+	if (!pmu_fw_event_code_valid(event_code))
 		return SBI_EINVAL;
 
 	if (SBI_PMU_FW_PLATFORM == event_code &&
@@ -507,7 +836,7 @@ static int pmu_ctr_stop_fw(struct sbi_pmu_hart_state *phs,
 			return ret;
 	}
 
-	phs->fw_counters_started &= ~BIT(cidx - num_hw_ctrs);
+	pmu_fw_counter_clear_started(phs, cidx, event_code);
 
 	return 0;
 }
@@ -532,14 +861,23 @@ int sbi_pmu_ctr_stop(unsigned long cbase, unsigned long cmask,
 		     unsigned long flag)
 {
 	struct sbi_pmu_hart_state *phs = pmu_thishart_state_ptr();
+	struct sbi_pmu_snapshot *snapshot = NULL;
 	int ret = SBI_EINVAL;
 	int event_idx_type;
 	uint32_t event_code;
+	uint64_t cval;
 	int i, cidx;
 
 	if ((cbase + sbi_fls(cmask)) >= total_ctrs)
 		return SBI_EINVAL;
 
+	if (flag & SBI_PMU_STOP_FLAG_TAKE_SNAPSHOT) {
+		snapshot = pmu_snapshot_map(phs);
+		if (!snapshot)
+			return SBI_ENO_SHMEM;
+		snapshot->ctr_overflow_mask = 0;
+	}
+
 	for_each_set_bit(i, &cmask, total_ctrs) {
 		cidx = i + cbase;
 		event_idx_type = pmu_ctr_validate(phs, cidx, &event_code);
@@ -547,17 +885,41 @@ int sbi_pmu_ctr_stop(unsigned long cbase, unsigned long cmask,
 			/* Continue the stop operation for other counters */
 			continue;
 
-		else if (event_idx_type == SBI_PMU_EVENT_TYPE_FW)
+		if (pmu_ctr_is_mux(cidx)) {
+			ret = pmu_mux_ctr_stop(phs, cidx);
+			if (snapshot && !pmu_mux_ctr_read(phs, cidx, &cval))
+				snapshot->ctr_values[i] = cval;
+			if (flag & SBI_PMU_STOP_FLAG_RESET)
+				phs->active_events[cidx] =
+						SBI_PMU_EVENT_IDX_INVALID;
+			continue;
+		} else if (event_idx_type == SBI_PMU_EVENT_TYPE_FW)
 			ret = pmu_ctr_stop_fw(phs, cidx, event_code);
 		else
 			ret = pmu_ctr_stop_hw(cidx);
 
+		/* Save counter value and overflow status after stopping */
+		if (snapshot) {
+			if (event_idx_type == SBI_PMU_EVENT_TYPE_FW) {
+				if (!sbi_pmu_ctr_fw_read(cidx, &cval))
+					snapshot->ctr_values[i] = cval;
+			} else {
+				snapshot->ctr_values[i] =
+						pmu_ctr_read_hw(cidx);
+				if (pmu_ctr_overflown_hw(cidx))
+					snapshot->ctr_overflow_mask |= BIT(i);
+			}
+		}
+
 		if (cidx > (CSR_INSTRET - CSR_CYCLE) && flag & SBI_PMU_STOP_FLAG_RESET) {
 			phs->active_events[cidx] = SBI_PMU_EVENT_IDX_INVALID;
 			pmu_reset_hw_mhpmevent(cidx);
 		}
 	}
 
+	if (snapshot)
+		pmu_snapshot_unmap();
+
 	return ret;
 }
 
@@ -668,7 +1030,7 @@ static int pmu_ctr_find_hw(struct sbi_pmu_hart_state *phs,
 			   unsigned long event_idx, uint64_t data)
 {
 	unsigned long ctr_mask;
-	int i, ret = 0, fixed_ctr, ctr_idx = SBI_ENOTSUPP;
+	int ctr, ret = 0, fixed_ctr, ctr_idx = SBI_ENOTSUPP;
 	struct sbi_pmu_hw_event *temp;
 	unsigned long mctr_inhbt = 0;
 	struct sbi_scratch *scratch = sbi_scratch_thishart_ptr();
@@ -681,43 +1043,38 @@ static int pmu_ctr_find_hw(struct sbi_pmu_hart_state *phs,
 	 * cycle/instret as well.
 	 */
 	fixed_ctr = pmu_ctr_find_fixed_hw(event_idx);
+	if (fixed_ctr >= 0 && (phs->hw_ctr_delegated & BIT(fixed_ctr)))
+		fixed_ctr = SBI_EINVAL;
 	if (fixed_ctr >= 0 &&
 	    !sbi_hart_has_extension(scratch, SBI_HART_EXT_SSCOFPMF))
 		return pmu_fixed_ctr_update_inhibit_bits(fixed_ctr, flags);
 
 	if (sbi_hart_priv_version(scratch) >= SBI_HART_PRIV_VER_1_11)
 		mctr_inhbt = csr_read(CSR_MCOUNTINHIBIT);
-	for (i = 0; i < num_hw_events; i++) {
-		temp = &hw_event_map[i];
-		if ((temp->start_idx > event_idx && event_idx < temp->end_idx) ||
-		    (temp->start_idx < event_idx && event_idx > temp->end_idx))
-			continue;
-
-		/* For raw events, event data is used as the select value */
-		if (event_idx == SBI_PMU_EVENT_RAW_IDX) {
-			uint64_t select_mask = temp->select_mask;
-
-			/* The non-event map bits of data should match the selector */
-			if (temp->select != (data & select_mask))
-				continue;
-		}
+	/* For raw events, event data is used as the select value */
+	for (temp = pmu_hw_event_find(event_idx, data, NULL); temp;
+	     temp = pmu_hw_event_find(event_idx, data, temp)) {
 		/* Fixed counters should not be part of the search */
 		ctr_mask = temp->counters & (cmask << cbase) &
-			   (~SBI_PMU_FIXED_CTR_MASK);
-		for_each_set_bit_from(cbase, &ctr_mask, SBI_PMU_HW_CTR_MAX) {
+			   (~SBI_PMU_FIXED_CTR_MASK) & ~pmu_mux_hw_mask(phs) &
+			   ~phs->hw_ctr_delegated;
+		ctr = cbase;
+		for_each_set_bit_from(ctr, &ctr_mask, SBI_PMU_HW_CTR_MAX) {
 			/**
 			 * Some of the platform may not support mcountinhibit.
 			 * Checking the active_events is enough for them
 			 */
-			if (phs->active_events[cbase] != SBI_PMU_EVENT_IDX_INVALID)
+			if (phs->active_events[ctr] != SBI_PMU_EVENT_IDX_INVALID)
 				continue;
 			/* If mcountinhibit is supported, the bit must be enabled */
 			if ((sbi_hart_priv_version(scratch) >= SBI_HART_PRIV_VER_1_11) &&
-			    !__test_bit(cbase, &mctr_inhbt))
+			    !__test_bit(ctr, &mctr_inhbt))
 				continue;
 			/* We found a valid counter that is not started yet */
-			ctr_idx = cbase;
+			ctr_idx = ctr;
 		}
+		if (ctr_idx != SBI_ENOTSUPP)
+			break;
 	}
 
 	if (ctr_idx == SBI_ENOTSUPP) {
@@ -739,6 +1096,322 @@ static int pmu_ctr_find_hw(struct sbi_pmu_hart_state *phs,
 }
 
 
+#ifdef CONFIG_SBI_PMU_MUX
+/* Interval between rotations of multiplexed counters in timer ticks */
+static u64 mux_interval_ticks;
+
+static u64 pmu_mux_interval(void)
+{
+	const struct sbi_timer_device *tdev;
+
+	if (!mux_interval_ticks) {
+		tdev = sbi_timer_get_device();
+		if (tdev)
+			mux_interval_ticks = (u64)(tdev->timer_freq / 1000) *
+					     CONFIG_SBI_PMU_MUX_INTERVAL_MS;
+	}
+
+	return mux_interval_ticks;
+}
+
+static inline struct sbi_pmu_mux_ctr *pmu_mux_ctr(
+				struct sbi_pmu_hart_state *phs, uint32_t cidx)
+{
+	return &phs->mux_ctrs[cidx - pmu_mux_ctr_base()];
+}
+
+/* Scale count by enabled/running without overflowing 64 bits */
+static uint64_t pmu_mux_scale(uint64_t count, uint64_t enabled,
+			      uint64_t running)
+{
+	uint64_t q, r;
+
+	if (!running || running >= enabled)
+		return count;
+
+	while (enabled >> 32) {
+		enabled >>= 1;
+		running >>= 1;
+	}
+	if (!running)
+		running = 1;
+
+	q = count / running;
+	r = count - q * running;
+
+	return q * enabled + (r * enabled) / running;
+}
+
+static void pmu_mux_update(struct sbi_pmu_hart_state *phs,
+			   struct sbi_pmu_mux_ctr *mctr, uint64_t now)
+{
+	unsigned int bits;
+	uint64_t val, delta;
+
+	if (mctr->hw_ctr >= 0) {
+		val = pmu_ctr_read_hw(mctr->hw_ctr);
+		delta = val - mctr->hw_last;
+		bits = sbi_hart_mhpm_bits(sbi_scratch_thishart_ptr());
+		if (bits < 64)
+			delta &= (1ULL << bits) - 1;
+		mctr->count += delta;
+		mctr->hw_last = val;
+		mctr->running += now - mctr->last;
+	}
+
+	if (phs->mux_started & BIT(mctr - phs->mux_ctrs))
+		mctr->enabled += now - mctr->last;
+	mctr->last = now;
+}
+
+static void pmu_mux_sched_out(struct sbi_pmu_hart_state *phs,
+			      struct sbi_pmu_mux_ctr *mctr, uint64_t now)
+{
+	pmu_mux_update(phs, mctr, now);
+	pmu_ctr_stop_hw(mctr->hw_ctr);
+	pmu_reset_hw_mhpmevent(mctr->hw_ctr);
+	phs->mux_hw_mask &= ~BIT(mctr->hw_ctr);
+	mctr->hw_ctr = -1;
+}
+
+static bool pmu_mux_sched_in(struct sbi_pmu_hart_state *phs,
+			     struct sbi_pmu_mux_ctr *mctr, uint32_t cidx)
+{
+	struct sbi_scratch *scratch = sbi_scratch_thishart_ptr();
+	unsigned long event_idx = phs->active_events[cidx];
+	struct sbi_pmu_hw_event *temp;
+	unsigned long ctr_mask;
+	int ctr;
+
+	for (temp = pmu_hw_event_find(event_idx, mctr->event_data, NULL);
+	     temp; temp = pmu_hw_event_find(event_idx, mctr->event_data, temp)) {
+		ctr_mask = temp->counters & ~SBI_PMU_FIXED_CTR_MASK &
+			   ~phs->mux_hw_mask & ~phs->hw_ctr_delegated;
+		for_each_set_bit(ctr, &ctr_mask, num_hw_ctrs) {
+			if (phs->active_events[ctr] != SBI_PMU_EVENT_IDX_INVALID)
+				continue;
+			if (pmu_update_hw_mhpmevent(temp, ctr, mctr->cfg_flags,
+						    event_idx, mctr->event_data))
+				continue;
+
+			/*
+			 * Start the counter without enabling its overflow
+			 * interrupt because supervisor software doesn't
+			 * know about this hardware counter.
+			 */
+			pmu_ctr_write_hw(ctr, 0);
+			mctr->hw_last = 0;
+			mctr->hw_ctr = ctr;
+			phs->mux_hw_mask |= BIT(ctr);
+			if (sbi_hart_priv_version(scratch) >=
+			    SBI_HART_PRIV_VER_1_11)
+				csr_clear(CSR_MCOUNTINHIBIT, BIT(ctr));
+			return true;
+		}
+	}
+
+	return false;
+}
+
+/* Give the started multiplexed counters the next turn on hardware */
+static void pmu_mux_rotate(struct sbi_pmu_hart_state *phs, uint64_t now)
+{
+	uint32_t i, idx, next = SBI_PMU_MUX_CTR_MAX;
+	struct sbi_pmu_mux_ctr *mctr;
+
+	for (i = 0; i < SBI_PMU_MUX_CTR_MAX; i++) {
+		mctr = &phs->mux_ctrs[i];
+		if (mctr->hw_ctr >= 0)
+			pmu_mux_sched_out(phs, mctr, now);
+		else
+			pmu_mux_update(phs, mctr, now);
+	}
+
+	for (i = 0; i < SBI_PMU_MUX_CTR_MAX; i++) {
+		idx = (phs->mux_next + i) % SBI_PMU_MUX_CTR_MAX;
+		if (!(phs->mux_started & BIT(idx)))
+			continue;
+		if (!pmu_mux_sched_in(phs, &phs->mux_ctrs[idx],
+				      pmu_mux_ctr_base() + idx) &&
+		    next == SBI_PMU_MUX_CTR_MAX)
+			next = idx;
+	}
+
+	/* Start from the first counter which missed its turn */
+	if (next < SBI_PMU_MUX_CTR_MAX)
+		phs->mux_next = next;
+	phs->mux_last_rotate = now;
+}
+
+/* Arm the rotation timer while multiplexed counters are started */
+static void pmu_mux_timer_arm(struct sbi_pmu_hart_state *phs)
+{
+	u64 interval = pmu_mux_interval();
+
+	if (!interval || !phs->mux_started)
+		return;
+
+	sbi_timer_event_arm(&phs->mux_timer,
+			    phs->mux_last_rotate + interval);
+}
+
+static void pmu_mux_timer_expired(struct sbi_timer_event *ev)
+{
+	struct sbi_pmu_hart_state *phs =
+		container_of(ev, struct sbi_pmu_hart_state, mux_timer);
+
+	if (!phs->mux_started)
+		return;
+
+	pmu_mux_rotate(phs, sbi_timer_value());
+	pmu_mux_timer_arm(phs);
+}
+
+static int pmu_mux_ctr_start(struct sbi_pmu_hart_state *phs, uint32_t cidx,
+			     uint64_t ival, bool ival_update)
+{
+	struct sbi_pmu_mux_ctr *mctr = pmu_mux_ctr(phs, cidx);
+	uint32_t idx = cidx - pmu_mux_ctr_base();
+	uint64_t now = sbi_timer_value();
+
+	if (phs->mux_started & BIT(idx))
+		return SBI_EALREADY_STARTED;
+
+	pmu_mux_update(phs, mctr, now);
+	if (ival_update) {
+		mctr->base = ival;
+		mctr->count = 0;
+		mctr->enabled = 0;
+		mctr->running = 0;
+	}
+	phs->mux_started |= BIT(idx);
+
+	/* Use a free hardware counter right away if there is one */
+	pmu_mux_sched_in(phs, mctr, cidx);
+
+	if (!sbi_timer_event_pending(&phs->mux_timer)) {
+		phs->mux_last_rotate = now;
+		pmu_mux_timer_arm(phs);
+	}
+
+	return 0;
+}
+
+static int pmu_mux_ctr_stop(struct sbi_pmu_hart_state *phs, uint32_t cidx)
+{
+	struct sbi_pmu_mux_ctr *mctr = pmu_mux_ctr(phs, cidx);
+	uint32_t idx = cidx - pmu_mux_ctr_base();
+	uint64_t now = sbi_timer_value();
+
+	if (!(phs->mux_started & BIT(idx)))
+		return SBI_EALREADY_STOPPED;
+
+	if (mctr->hw_ctr >= 0)
+		pmu_mux_sched_out(phs, mctr, now);
+	else
+		pmu_mux_update(phs, mctr, now);
+	phs->mux_started &= ~BIT(idx);
+
+	if (!phs->mux_started)
+		sbi_timer_event_cancel(&phs->mux_timer);
+
+	return 0;
+}
+
+static void pmu_mux_ctr_clear(struct sbi_pmu_hart_state *phs, uint32_t cidx)
+{
+	struct sbi_pmu_mux_ctr *mctr = pmu_mux_ctr(phs, cidx);
+
+	pmu_mux_update(phs, mctr, sbi_timer_value());
+	mctr->base = 0;
+	mctr->count = 0;
+	mctr->enabled = 0;
+	mctr->running = 0;
+}
+
+static int pmu_mux_ctr_read(struct sbi_pmu_hart_state *phs, uint32_t cidx,
+			    uint64_t *cval)
+{
+	struct sbi_pmu_mux_ctr *mctr = pmu_mux_ctr(phs, cidx);
+	uint64_t now;
+
+	if (phs->active_events[cidx] == SBI_PMU_EVENT_IDX_INVALID)
+		return SBI_EINVAL;
+
+	if (phs->mux_started) {
+		now = sbi_timer_value();
+		pmu_mux_update(phs, mctr, now);
+		/* Rotate here as well in case the rotation timer is late */
+		if (now - phs->mux_last_rotate >= pmu_mux_interval()) {
+			pmu_mux_rotate(phs, now);
+			pmu_mux_timer_arm(phs);
+		}
+	}
+
+	*cval = mctr->base + pmu_mux_scale(mctr->count, mctr->enabled,
+					   mctr->running);
+
+	return 0;
+}
+
+/**
+ * Find a free multiplexed counter for a hardware event which has
+ * a mapping but no free hardware counter.
+ */
+static int pmu_ctr_find_mux(struct sbi_pmu_hart_state *phs,
+			    unsigned long cbase, unsigned long cmask,
+			    unsigned long flags, unsigned long event_idx,
+			    uint64_t data)
+{
+	struct sbi_pmu_mux_ctr *mctr;
+	int i, cidx;
+
+	if (!pmu_hw_event_find(event_idx, data, NULL))
+		return SBI_ENOTSUPP;
+
+	for_each_set_bit(i, &cmask, BITS_PER_LONG) {
+		cidx = i + cbase;
+		if (!pmu_ctr_is_mux(cidx))
+			continue;
+		if (phs->active_events[cidx] != SBI_PMU_EVENT_IDX_INVALID)
+			continue;
+
+		mctr = pmu_mux_ctr(phs, cidx);
+		sbi_memset(mctr, 0, sizeof(*mctr));
+		mctr->event_data = data;
+		mctr->cfg_flags = flags;
+		mctr->hw_ctr = -1;
+		mctr->last = sbi_timer_value();
+		return cidx;
+	}
+
+	return SBI_ENOTSUPP;
+}
+
+static void pmu_mux_reset(struct sbi_pmu_hart_state *phs)
+{
+	int i;
+
+	sbi_memset(phs->mux_ctrs, 0, sizeof(phs->mux_ctrs));
+	for (i = 0; i < SBI_PMU_MUX_CTR_MAX; i++)
+		phs->mux_ctrs[i].hw_ctr = -1;
+	phs->mux_started = 0;
+	phs->mux_hw_mask = 0;
+	phs->mux_next = 0;
+	phs->mux_last_rotate = 0;
+	/*
+	 * Called on HART init and exit where the timer queue of the
+	 * HART is reset as well so the event is simply re-initialized.
+	 */
+	sbi_timer_event_init(&phs->mux_timer, pmu_mux_timer_expired);
+}
+#else
+#define pmu_ctr_find_mux(__phs, __cbase, __cmask, __flags, __eidx, __data) \
+	SBI_ENOTSUPP
+#define pmu_mux_ctr_clear(__phs, __cidx)	do { } while (0)
+#define pmu_mux_reset(__phs)			do { } while (0)
+#endif
+
 /**
  * Any firmware counter can map to any firmware event.
  * Thus, select the first available fw counter after sanity
@@ -750,14 +1423,12 @@ static int pmu_ctr_find_fw(struct sbi_pmu_hart_state *phs,
 {
 	int i, cidx;
 
-	if ((event_code >= SBI_PMU_FW_MAX &&
-	    event_code <= SBI_PMU_FW_RESERVED_MAX) ||
-	    event_code > SBI_PMU_FW_PLATFORM)
+	if (!pmu_fw_event_code_valid(event_code))
 		return SBI_EINVAL;
 
 	for_each_set_bit(i, &cmask, BITS_PER_LONG) {
 		cidx = i + cbase;
-		if (cidx < num_hw_ctrs || total_ctrs <= cidx)
+		if (cidx < num_hw_ctrs || pmu_mux_ctr_base() <= cidx)
 			continue;
 		if (phs->active_events[i] != SBI_PMU_EVENT_IDX_INVALID)
 			continue;
@@ -818,6 +1489,11 @@ int sbi_pmu_ctr_cfg_match(unsigned long cidx_base, unsigned long cidx_mask,
 	} else {
 		ctr_idx = pmu_ctr_find_hw(phs, cidx_base, cidx_mask, flags,
 					  event_idx, event_data);
+		/* Fall back to a multiplexed counter if all are in use */
+		if (ctr_idx < 0)
+			ctr_idx = pmu_ctr_find_mux(phs, cidx_base, cidx_mask,
+						   flags, event_idx,
+						   event_data);
 	}
 
 	if (ctr_idx < 0)
@@ -825,7 +1501,12 @@ int sbi_pmu_ctr_cfg_match(unsigned long cidx_base, unsigned long cidx_mask,
 
 	phs->active_events[ctr_idx] = event_idx;
 skip_match:
-	if (event_type == SBI_PMU_EVENT_TYPE_HW) {
+	if (pmu_ctr_is_mux(ctr_idx)) {
+		if (flags & SBI_PMU_CFG_FLAG_CLEAR_VALUE)
+			pmu_mux_ctr_clear(phs, ctr_idx);
+		if (flags & SBI_PMU_CFG_FLAG_AUTO_START)
+			pmu_mux_ctr_start(phs, ctr_idx, 0, false);
+	} else if (event_type == SBI_PMU_EVENT_TYPE_HW) {
 		if (flags & SBI_PMU_CFG_FLAG_CLEAR_VALUE)
 			pmu_ctr_write_hw(ctr_idx, 0);
 		if (flags & SBI_PMU_CFG_FLAG_AUTO_START)
@@ -842,17 +1523,27 @@ skip_match:
 				if (ret)
 					return ret;
 			}
-			phs->fw_counters_started |= BIT(ctr_idx - num_hw_ctrs);
+			pmu_fw_counter_set_started(phs, ctr_idx, event_code);
 		}
 	}
 
 	return ctr_idx;
 }
 
+static void pmu_fw_event_add(struct sbi_pmu_hart_state *phs, int slot,
+			     uint64_t value)
+{
+	unsigned long ctrs = phs->fw_event_counters[slot];
+
+	/* Update every started counter tracking this event */
+	while (ctrs) {
+		phs->fw_counters_data[sbi_ffs(ctrs)] += value;
+		ctrs &= ctrs - 1;
+	}
+}
+
 int sbi_pmu_ctr_incr_fw(enum sbi_pmu_fw_event_code_id fw_id)
 {
-	u32 cidx;
-	uint64_t *fcounter = NULL;
 	struct sbi_pmu_hart_state *phs = pmu_thishart_state_ptr();
 
 	if (likely(!phs->fw_counters_started))
@@ -861,23 +1552,57 @@ int sbi_pmu_ctr_incr_fw(enum sbi_pmu_fw_event_code_id fw_id)
 	if (unlikely(fw_id >= SBI_PMU_FW_MAX))
 		return SBI_EINVAL;
 
-	for (cidx = num_hw_ctrs; cidx < total_ctrs; cidx++) {
-		if (get_cidx_code(phs->active_events[cidx]) == fw_id &&
-		    (phs->fw_counters_started & BIT(cidx - num_hw_ctrs))) {
-			fcounter = &phs->fw_counters_data[cidx - num_hw_ctrs];
-			break;
-		}
-	}
-
-	if (fcounter)
-		(*fcounter)++;
+	pmu_fw_event_add(phs, fw_id, 1);
 
 	return 0;
 }
 
+unsigned long sbi_pmu_fw_cycles_begin(void)
+{
+	struct sbi_pmu_hart_state *phs = pmu_thishart_state_ptr();
+
+	if (likely(!phs->fw_counters_started))
+		return 0;
+
+	return csr_read(CSR_MCYCLE);
+}
+
+void sbi_pmu_fw_cycles_end(enum sbi_pmu_fw_cycles_event_id fw_id,
+			   unsigned long start)
+{
+	struct sbi_pmu_hart_state *phs = pmu_thishart_state_ptr();
+	unsigned long delta;
+
+	/* Skip activities which began before any counter was started */
+	if (likely(!start || !phs->fw_counters_started))
+		return;
+
+	if (unlikely(fw_id < SBI_PMU_FW_CYCLES_BASE ||
+		     fw_id >= SBI_PMU_FW_CYCLES_MAX))
+		return;
+
+	/* Unsigned subtraction handles a wrap of mcycle on RV32 */
+	delta = csr_read(CSR_MCYCLE) - start;
+	pmu_fw_event_add(phs, pmu_fw_event_slot(fw_id), delta);
+}
+
+void sbi_pmu_fw_impl_incr(enum sbi_pmu_fw_count_event_id fw_id)
+{
+	struct sbi_pmu_hart_state *phs = pmu_thishart_state_ptr();
+
+	if (likely(!phs->fw_counters_started))
+		return;
+
+	if (unlikely(fw_id < SBI_PMU_FW_COUNT_BASE ||
+		     fw_id >= SBI_PMU_FW_COUNT_MAX))
+		return;
+
+	pmu_fw_event_add(phs, pmu_fw_event_slot(fw_id), 1);
+}
+
 unsigned long sbi_pmu_num_ctr(void)
 {
-	return (num_hw_ctrs + SBI_PMU_FW_CTR_MAX);
+	return total_ctrs;
 }
 
 int sbi_pmu_ctr_get_info(uint32_t cidx, unsigned long *ctr_info)
@@ -885,11 +1610,16 @@ int sbi_pmu_ctr_get_info(uint32_t cidx, unsigned long *ctr_info)
 	int width;
 	union sbi_pmu_ctr_info cinfo = {0};
 	struct sbi_scratch *scratch = sbi_scratch_thishart_ptr();
+	struct sbi_pmu_hart_state *phs = pmu_get_hart_state_ptr(scratch);
 
 	/* Sanity check. Counter1 is not mapped at all */
 	if (cidx >= total_ctrs || cidx == 1)
 		return SBI_EINVAL;
 
+	/* Delegated counters are not part of the SBI PMU counter pool */
+	if (cidx < num_hw_ctrs && (phs->hw_ctr_delegated & BIT(cidx)))
+		return SBI_EINVAL;
+
 	/* We have 31 HW counters with 31 being the last index(MHPMCOUNTER31) */
 	if (cidx < num_hw_ctrs) {
 		cinfo.type = SBI_PMU_CTR_TYPE_HW;
@@ -899,6 +1629,13 @@ int sbi_pmu_ctr_get_info(uint32_t cidx, unsigned long *ctr_info)
 			cinfo.width = 63;
 		else
 			cinfo.width = sbi_hart_mhpm_bits(scratch) - 1;
+	} else if (pmu_ctr_is_mux(cidx)) {
+		/*
+		 * Multiplexed counters have no CSR so supervisor software
+		 * must read them with COUNTER_FW_READ for any event type.
+		 */
+		cinfo.type = SBI_PMU_CTR_TYPE_FW;
+		cinfo.width = 63;
 	} else {
 		/* it's a firmware counter */
 		cinfo.type = SBI_PMU_CTR_TYPE_FW;
@@ -925,7 +1662,61 @@ static void pmu_reset_event_map(struct sbi_pmu_hart_state *phs)
 		phs->active_events[j] = SBI_PMU_EVENT_IDX_INVALID;
 	for (j = 0; j < SBI_PMU_FW_CTR_MAX; j++)
 		phs->fw_counters_data[j] = 0;
+	for (j = 0; j < array_size(phs->fw_event_counters); j++)
+		phs->fw_event_counters[j] = 0;
 	phs->fw_counters_started = 0;
+	phs->snapshot_enabled = false;
+	phs->snapshot_addr = 0;
+	pmu_mux_reset(phs);
+}
+
+int sbi_pmu_snapshot_set_shmem(unsigned long shmem_lo,
+			       unsigned long shmem_hi, unsigned long flags)
+{
+	struct sbi_pmu_hart_state *phs = pmu_thishart_state_ptr();
+	struct sbi_pmu_snapshot *snapshot;
+	unsigned long smode = (csr_read(CSR_MSTATUS) & MSTATUS_MPP) >>
+				MSTATUS_MPP_SHIFT;
+
+	if (flags)
+		return SBI_EINVAL;
+
+	/* Drop the cached mapping of the previously registered area */
+	if (phs->snapshot_enabled)
+		sbi_hart_invalidate_saddr(phs->snapshot_addr,
+					  SBI_PMU_SNAPSHOT_SIZE);
+
+	/* All-ones physical address disables the snapshot */
+	if (shmem_lo == -1UL && shmem_hi == -1UL) {
+		phs->snapshot_enabled = false;
+		phs->snapshot_addr = 0;
+		return 0;
+	}
+
+	/*
+	 * M-mode can only access the lower XLEN bits of the physical
+	 * address space, so reject a non-zero upper half.
+	 */
+	if (shmem_hi || (shmem_lo & (SBI_PMU_SNAPSHOT_SIZE - 1)))
+		return SBI_EINVALID_ADDR;
+
+	if (!sbi_domain_check_addr_range(sbi_domain_thishart_ptr(),
+					 shmem_lo, SBI_PMU_SNAPSHOT_SIZE, smode,
+					 SBI_DOMAIN_READ | SBI_DOMAIN_WRITE))
+		return SBI_EINVALID_ADDR;
+
+	phs->snapshot_addr = shmem_lo;
+	phs->snapshot_enabled = true;
+
+	snapshot = pmu_snapshot_map(phs);
+	if (!snapshot) {
+		phs->snapshot_enabled = false;
+		return SBI_EFAIL;
+	}
+	sbi_memset(snapshot, 0, SBI_PMU_SNAPSHOT_SIZE);
+	pmu_snapshot_unmap();
+
+	return 0;
 }
 
 const struct sbi_pmu_device *sbi_pmu_get_device(void)
@@ -964,12 +1755,6 @@ int sbi_pmu_init(struct sbi_scratch *scratch, bool cold_boot)
 		if (!hw_event_map)
 			return SBI_ENOMEM;
 
-		phs_ptr_offset = sbi_scratch_alloc_type_offset(void *);
-		if (!phs_ptr_offset) {
-			sbi_free(hw_event_map);
-			return SBI_ENOMEM;
-		}
-
 		plat = sbi_platform_ptr(scratch);
 		/* Initialize hw pmu events */
 		sbi_platform_pmu_init(plat);
@@ -984,7 +1769,8 @@ int sbi_pmu_init(struct sbi_scratch *scratch, bool cold_boot)
 		if (num_hw_ctrs > SBI_PMU_HW_CTR_MAX)
 			return SBI_EINVAL;
 
-		total_ctrs = num_hw_ctrs + SBI_PMU_FW_CTR_MAX;
+		total_ctrs = num_hw_ctrs + SBI_PMU_FW_CTR_MAX +
+			     SBI_PMU_MUX_CTR_MAX;
 	}
 
 	phs = pmu_get_hart_state_ptr(scratch);
@@ -1005,5 +1791,15 @@ int sbi_pmu_init(struct sbi_scratch *scratch, bool cold_boot)
 	phs->active_events[2] = (SBI_PMU_EVENT_TYPE_HW << SBI_PMU_EVENT_IDX_TYPE_OFFSET) |
 				SBI_PMU_HW_INSTRUCTIONS;
 
+	/*
+	 * Counters delegated to S-mode are programmed by S-mode directly
+	 * so keep them out of the SBI PMU counter pool.
+	 */
+	phs->hw_ctr_delegated = sbi_pmu_hw_ctr_delegated_mask(scratch);
+	if (phs->hw_ctr_delegated & BIT(0))
+		phs->active_events[0] = SBI_PMU_EVENT_IDX_INVALID;
+	if (phs->hw_ctr_delegated & BIT(2))
+		phs->active_events[2] = SBI_PMU_EVENT_IDX_INVALID;
+
 	return 0;
 }
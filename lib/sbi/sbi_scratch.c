@@ -8,6 +8,7 @@
  */
 
 #include <sbi/riscv_locks.h>
+#include <sbi/sbi_bitmap.h>
 #include <sbi/sbi_hart.h>
 #include <sbi/sbi_hartmask.h>
 #include <sbi/sbi_platform.h>
@@ -18,8 +19,22 @@ u32 last_hartindex_having_scratch = 0;
 u32 hartindex_to_hartid_table[SBI_HARTMASK_MAX_BITS + 1] = { -1U };
 struct sbi_scratch *hartindex_to_scratch_table[SBI_HARTMASK_MAX_BITS + 1] = { 0 };
 
+/*
+ * The extra space allocator tracks sbi_scratch in pointer sized granules
+ * and tags every cache line with the allocation class which owns it.
+ */
+#define EXTRA_GRANULE_SIZE		__SIZEOF_POINTER__
+#define EXTRA_GRANULE_COUNT		(SBI_SCRATCH_SIZE / EXTRA_GRANULE_SIZE)
+#define EXTRA_LINE_GRANULES		\
+	(SBI_SCRATCH_CACHELINE_SIZE / EXTRA_GRANULE_SIZE)
+#define EXTRA_LINE_COUNT		\
+	(SBI_SCRATCH_SIZE / SBI_SCRATCH_CACHELINE_SIZE)
+#define EXTRA_LINE_FREE			0
+
 static spinlock_t extra_lock = SPIN_LOCK_INITIALIZER;
-static unsigned long extra_offset = SBI_SCRATCH_EXTRA_SPACE_OFFSET;
+static DECLARE_BITMAP(extra_used, EXTRA_GRANULE_COUNT);
+static DECLARE_BITMAP(extra_head, EXTRA_GRANULE_COUNT);
+static u8 extra_line_tag[EXTRA_LINE_COUNT];
 
 u32 sbi_hartid_to_hartindex(u32 hartid)
 {
@@ -34,54 +49,121 @@ u32 sbi_hartid_to_hartindex(u32 hartid)
 
 typedef struct sbi_scratch *(*hartid2scratch)(ulong hartid, ulong hartindex);
 
+static inline u8 extra_class_tag(enum sbi_scratch_alloc_class aclass)
+{
+	return (u8)aclass + 1;
+}
+
+static void extra_mark_used(unsigned long first, unsigned long count,
+			    enum sbi_scratch_alloc_class aclass)
+{
+	unsigned long l;
+
+	bitmap_set(extra_used, first, count);
+	__set_bit(first, extra_head);
+	for (l = first / EXTRA_LINE_GRANULES;
+	     l <= (first + count - 1) / EXTRA_LINE_GRANULES; l++)
+		extra_line_tag[l] = extra_class_tag(aclass);
+}
+
+static bool extra_range_fits(unsigned long first, unsigned long count,
+			     enum sbi_scratch_alloc_class aclass)
+{
+	unsigned long g, l;
+	u8 tag;
+
+	if (EXTRA_GRANULE_COUNT < (first + count))
+		return false;
+
+	for (g = first; g < (first + count); g++) {
+		if (__test_bit(g, extra_used))
+			return false;
+	}
+
+	for (l = first / EXTRA_LINE_GRANULES;
+	     l <= (first + count - 1) / EXTRA_LINE_GRANULES; l++) {
+		tag = extra_line_tag[l];
+		if (tag == EXTRA_LINE_FREE)
+			continue;
+		/* Remote written allocations never share cache lines */
+		if (aclass == SBI_SCRATCH_ALLOC_REMOTE_WRITTEN ||
+		    tag != extra_class_tag(aclass))
+			return false;
+	}
+
+	return true;
+}
+
 int sbi_scratch_init(struct sbi_scratch *scratch)
 {
 	u32 i, h;
+	struct sbi_scratch *hscratch;
 	const struct sbi_platform *plat = sbi_platform_ptr(scratch);
 
 	for (i = 0; i < plat->hart_count; i++) {
 		h = (plat->hart_index2id) ? plat->hart_index2id[i] : i;
+		hscratch = ((hartid2scratch)scratch->hartid_to_scratch)(h, i);
 		hartindex_to_hartid_table[i] = h;
-		hartindex_to_scratch_table[i] =
-			((hartid2scratch)scratch->hartid_to_scratch)(h, i);
+		hartindex_to_scratch_table[i] = hscratch;
+		if (!hscratch)
+			continue;
+
+		/* Drivers fill the rest of the hot context later */
+		sbi_memset(&hscratch->hot, 0, sizeof(hscratch->hot));
+		hscratch->hot.hartindex = i;
 	}
 
 	last_hartindex_having_scratch = plat->hart_count - 1;
 
+	/*
+	 * The fixed members of sbi_scratch are read on every trap so
+	 * treat their cache lines as local hot.
+	 */
+#ifdef CONFIG_SBI_SCRATCH_ALLOC_CLASSES
+	extra_mark_used(0, SBI_SCRATCH_EXTRA_SPACE_OFFSET / EXTRA_GRANULE_SIZE,
+			SBI_SCRATCH_ALLOC_LOCAL_HOT);
+#else
+	extra_mark_used(0, SBI_SCRATCH_EXTRA_SPACE_OFFSET / EXTRA_GRANULE_SIZE,
+			SBI_SCRATCH_ALLOC_COLD);
+#endif
+
 	return 0;
 }
 
-unsigned long sbi_scratch_alloc_offset(unsigned long size)
+unsigned long sbi_scratch_alloc_class_offset(unsigned long size,
+					enum sbi_scratch_alloc_class aclass)
 {
 	u32 i;
 	void *ptr;
-	unsigned long ret = 0;
+	unsigned long g, count, step, ret = 0;
 	struct sbi_scratch *rscratch;
 
-	/*
-	 * We have a simple brain-dead allocator which never expects
-	 * anything to be free-ed hence it keeps incrementing the
-	 * next allocation offset until it runs-out of space.
-	 *
-	 * In future, we will have more sophisticated allocator which
-	 * will allow us to re-claim free-ed space.
-	 */
-
-	if (!size)
+	if (!size || SBI_SCRATCH_ALLOC_CLASS_MAX <= aclass)
 		return 0;
-
-	size += __SIZEOF_POINTER__ - 1;
-	size &= ~((unsigned long)__SIZEOF_POINTER__ - 1);
+#ifndef CONFIG_SBI_SCRATCH_ALLOC_CLASSES
+	aclass = SBI_SCRATCH_ALLOC_COLD;
+#endif
+
+	count = (size + EXTRA_GRANULE_SIZE - 1) / EXTRA_GRANULE_SIZE;
+	step = 1;
+	if (aclass == SBI_SCRATCH_ALLOC_REMOTE_WRITTEN) {
+		/* Pad to whole cache lines to avoid false sharing */
+		count += EXTRA_LINE_GRANULES - 1;
+		count &= ~((unsigned long)EXTRA_LINE_GRANULES - 1);
+		step = EXTRA_LINE_GRANULES;
+	}
+	size = count * EXTRA_GRANULE_SIZE;
 
 	spin_lock(&extra_lock);
 
-	if (SBI_SCRATCH_SIZE < (extra_offset + size))
-		goto done;
-
-	ret = extra_offset;
-	extra_offset += size;
+	for (g = 0; g < EXTRA_GRANULE_COUNT; g += step) {
+		if (extra_range_fits(g, count, aclass)) {
+			extra_mark_used(g, count, aclass);
+			ret = g * EXTRA_GRANULE_SIZE;
+			break;
+		}
+	}
 
-done:
 	spin_unlock(&extra_lock);
 
 	if (ret) {
@@ -99,22 +181,53 @@ done:
 
 void sbi_scratch_free_offset(unsigned long offset)
 {
+	unsigned long g, first, l, lfirst, llast;
+
 	if ((offset < SBI_SCRATCH_EXTRA_SPACE_OFFSET) ||
-	    (SBI_SCRATCH_SIZE <= offset))
+	    (SBI_SCRATCH_SIZE <= offset) ||
+	    (offset & (EXTRA_GRANULE_SIZE - 1)))
 		return;
 
-	/*
-	 * We don't actually free-up because it's a simple
-	 * brain-dead allocator.
-	 */
+	first = offset / EXTRA_GRANULE_SIZE;
+
+	spin_lock(&extra_lock);
+
+	if (!__test_bit(first, extra_head))
+		goto done;
+
+	__clear_bit(first, extra_head);
+	for (g = first; g < EXTRA_GRANULE_COUNT; g++) {
+		if (!__test_bit(g, extra_used) || __test_bit(g, extra_head))
+			break;
+		__clear_bit(g, extra_used);
+	}
+
+	/* Release cache lines which are no longer used by anyone */
+	lfirst = first / EXTRA_LINE_GRANULES;
+	llast = (g - 1) / EXTRA_LINE_GRANULES;
+	for (l = lfirst; l <= llast; l++) {
+		for (g = l * EXTRA_LINE_GRANULES;
+		     g < (l + 1) * EXTRA_LINE_GRANULES; g++) {
+			if (__test_bit(g, extra_used))
+				break;
+		}
+		if (g == (l + 1) * EXTRA_LINE_GRANULES)
+			extra_line_tag[l] = EXTRA_LINE_FREE;
+	}
+
+done:
+	spin_unlock(&extra_lock);
 }
 
 unsigned long sbi_scratch_used_space(void)
 {
-	unsigned long ret = 0;
+	unsigned long g, ret = 0;
 
 	spin_lock(&extra_lock);
-	ret = extra_offset;
+	for (g = 0; g < EXTRA_GRANULE_COUNT; g++) {
+		if (__test_bit(g, extra_used))
+			ret += EXTRA_GRANULE_SIZE;
+	}
 	spin_unlock(&extra_lock);
 
 	return ret;
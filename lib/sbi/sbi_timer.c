@@ -11,6 +11,7 @@
 #include <sbi/riscv_barrier.h>
 #include <sbi/riscv_encoding.h>
 #include <sbi/sbi_console.h>
+#include <sbi/sbi_domain.h>
 #include <sbi/sbi_error.h>
 #include <sbi/sbi_hart.h>
 #include <sbi/sbi_platform.h>
@@ -18,7 +19,22 @@
 #include <sbi/sbi_scratch.h>
 #include <sbi/sbi_timer.h>
 
+/** Per-HART timer state */
+struct sbi_timer_hart {
+	/** Armed firmware timer events sorted by deadline */
+	struct sbi_dlist events;
+	/** S-mode deadline injected through STIP (without Sstc) */
+	u64 smode_deadline;
+	/** Deadline programmed in the timer device (~0 if none) */
+	u64 programmed;
+	/** Domain whose timer slack is cached below */
+	const struct sbi_domain *slack_dom;
+	/** Timer slack of the cached domain in timer ticks */
+	u64 slack_ticks;
+};
+
 static unsigned long time_delta_off;
+static unsigned long timer_hart_off;
 static u64 (*get_time_val)(void);
 static const struct sbi_timer_device *timer_dev = NULL;
 
@@ -129,8 +145,124 @@ void sbi_timer_set_delta_upper(ulong delta_upper)
 	*time_delta |= ((u64)delta_upper << 32);
 }
 
+static inline struct sbi_timer_hart *timer_thishart_ptr(void)
+{
+	return sbi_scratch_offset_ptr(sbi_scratch_thishart_ptr(),
+				      timer_hart_off);
+}
+
+static void timer_hart_reset(struct sbi_scratch *scratch)
+{
+	struct sbi_timer_hart *th = sbi_scratch_offset_ptr(scratch,
+							   timer_hart_off);
+	struct sbi_timer_event *ev;
+
+	/* Dropped events must not look armed, the queue is zero at first */
+	while (th->events.next && !sbi_list_empty(&th->events)) {
+		ev = sbi_list_first_entry(&th->events,
+					  struct sbi_timer_event, head);
+		sbi_list_del_init(&ev->head);
+	}
+
+	SBI_INIT_LIST_HEAD(&th->events);
+	th->smode_deadline = -1ULL;
+	th->programmed = -1ULL;
+	th->slack_dom = NULL;
+	th->slack_ticks = 0;
+}
+
+/* Get the timer slack of the current domain in timer ticks */
+static u64 timer_hart_slack(struct sbi_timer_hart *th)
+{
+	const struct sbi_domain *dom = sbi_domain_thishart_ptr();
+
+	if (th->slack_dom != dom) {
+		th->slack_dom = dom;
+		th->slack_ticks = 0;
+		if (dom && dom->timer_slack_us && timer_dev)
+			th->slack_ticks = ((u64)dom->timer_slack_us *
+					   timer_dev->timer_freq) / 1000000;
+	}
+
+	return th->slack_ticks;
+}
+
+/*
+ * Program the M-mode timer with the earliest deadline of the firmware
+ * events and (without Sstc) the S-mode timer of the current HART. An
+ * S-mode deadline within the timer slack before the first firmware
+ * event is delivered together with that event.
+ */
+static void timer_hart_program(struct sbi_timer_hart *th)
+{
+	struct sbi_timer_event *ev;
+	u64 next = th->smode_deadline;
+
+	if (!sbi_list_empty(&th->events)) {
+		ev = sbi_list_first_entry(&th->events,
+					  struct sbi_timer_event, head);
+		if (ev->deadline < next ||
+		    ev->deadline - next <= th->slack_ticks)
+			next = ev->deadline;
+	}
+
+	if (next == -1ULL || !timer_dev || !timer_dev->timer_event_start) {
+		th->programmed = -1ULL;
+		csr_clear(CSR_MIE, MIP_MTIP);
+		return;
+	}
+
+	/* Avoid the MMIO write when the deadline did not change */
+	if (next != th->programmed) {
+		timer_dev->timer_event_start(next);
+		th->programmed = next;
+	}
+	csr_set(CSR_MIE, MIP_MTIP);
+}
+
+int sbi_timer_event_arm(struct sbi_timer_event *ev, u64 deadline)
+{
+	struct sbi_timer_hart *th = timer_thishart_ptr();
+	struct sbi_timer_event *pos;
+
+	if (!ev || !ev->callback)
+		return SBI_EINVAL;
+	if (!timer_dev || !timer_dev->timer_event_start)
+		return SBI_ENODEV;
+	/* The queue of this HART is set up by sbi_timer_init() */
+	if (!timer_hart_off || !th->events.next)
+		return SBI_ENODEV;
+
+	sbi_list_del_init(&ev->head);
+	ev->deadline = deadline;
+
+	/* Keep the queue sorted, events with equal deadlines stay FIFO */
+	sbi_list_for_each_entry(pos, &th->events, head) {
+		if (deadline < pos->deadline)
+			break;
+	}
+	sbi_list_add_tail(&ev->head, &pos->head);
+
+	timer_hart_program(th);
+	return 0;
+}
+
+void sbi_timer_event_cancel(struct sbi_timer_event *ev)
+{
+	struct sbi_timer_hart *th = timer_thishart_ptr();
+
+	if (!ev || !sbi_timer_event_pending(ev))
+		return;
+
+	sbi_list_del_init(&ev->head);
+	timer_hart_program(th);
+}
+
 void sbi_timer_event_start(u64 next_event)
 {
+	struct sbi_timer_hart *th;
+	u64 slack, prev;
+
 	sbi_pmu_ctr_incr_fw(SBI_PMU_FW_SET_TIMER);
 
 	/**
@@ -145,22 +277,96 @@ void sbi_timer_event_start(u64 next_event)
 		csr_write(CSR_STIMECMP, next_event);
 #endif
 	} else if (timer_dev && timer_dev->timer_event_start) {
-		timer_dev->timer_event_start(next_event);
+		th = timer_thishart_ptr();
+		slack = timer_hart_slack(th);
+		prev = th->programmed;
+
+		if (slack && next_event < -1ULL - slack) {
+			/* Round the deadline up to the slack grain */
+			next_event = ((next_event + slack - 1) / slack) * slack;
+
+			/* Defer to an already pending deadline within slack */
+			if (prev != -1ULL && next_event <= prev &&
+			    prev - next_event <= slack)
+				next_event = prev;
+		}
+
+		th->smode_deadline = next_event;
 		csr_clear(CSR_MIP, MIP_STIP);
+		timer_hart_program(th);
+
+		if (slack && prev != -1ULL && th->programmed == prev)
+			sbi_pmu_fw_impl_incr(SBI_PMU_FW_TIMER_COALESCED);
 	}
-	csr_set(CSR_MIE, MIP_MTIP);
 }
 
 void sbi_timer_process(void)
 {
+	struct sbi_timer_hart *th = timer_thishart_ptr();
+	struct sbi_timer_event *ev;
+	u64 now;
+
 	csr_clear(CSR_MIE, MIP_MTIP);
+
+	/* Without a time source treat every deadline as expired */
+	now = (get_time_val) ? get_time_val() : -1ULL;
+
+	/* Dispatch expired firmware events in deadline order */
+	while (!sbi_list_empty(&th->events)) {
+		ev = sbi_list_first_entry(&th->events,
+					  struct sbi_timer_event, head);
+		if (now < ev->deadline)
+			break;
+
+		sbi_list_del_init(&ev->head);
+		ev->callback(ev);
+	}
+
 	/*
 	 * If sstc extension is available, supervisor can receive the timer
-	 * directly without M-mode come in between. This function should
-	 * only invoked if M-mode programs the timer for its own purpose.
+	 * directly without M-mode come in between. Otherwise inject the
+	 * S-mode timer interrupt once its deadline has passed.
 	 */
-	if (!sbi_hart_has_extension(sbi_scratch_thishart_ptr(), SBI_HART_EXT_SSTC))
+	if (th->smode_deadline <= now) {
+		th->smode_deadline = -1ULL;
 		csr_set(CSR_MIP, MIP_STIP);
+		sbi_pmu_fw_impl_incr(SBI_PMU_FW_TIMER_DELIVERED);
+	}
+
+	timer_hart_program(th);
+}
+
+void sbi_timer_smode_swap(u64 *deadline, bool *pending)
+{
+	struct sbi_timer_hart *th = timer_thishart_ptr();
+	u64 next = *deadline;
+
+	/*
+	 * With Sstc the pending state follows stimecmp so swapping
+	 * stimecmp is enough.
+	 */
+	if (sbi_hart_has_extension(sbi_scratch_thishart_ptr(),
+				   SBI_HART_EXT_SSTC)) {
+#if __riscv_xlen == 32
+		*deadline = csr_read(CSR_STIMECMP);
+		*deadline |= (u64)csr_read(CSR_STIMECMPH) << 32;
+		csr_write(CSR_STIMECMP, -1UL);
+		csr_write(CSR_STIMECMPH, next >> 32);
+		csr_write(CSR_STIMECMP, next & 0xFFFFFFFF);
+#else
+		*deadline = csr_swap(CSR_STIMECMP, next);
+#endif
+		*pending = false;
+		return;
+	}
+
+	*deadline = th->smode_deadline;
+	th->smode_deadline = next;
+	if (*pending)
+		*pending = csr_read_set(CSR_MIP, MIP_STIP) & MIP_STIP;
+	else
+		*pending = csr_read_clear(CSR_MIP, MIP_STIP) & MIP_STIP;
+	timer_hart_program(th);
 }
 
 const struct sbi_timer_device *sbi_timer_get_device(void)
@@ -184,19 +390,27 @@ int sbi_timer_init(struct sbi_scratch *scratch, bool cold_boot)
 	const struct sbi_platform *plat = sbi_platform_ptr(scratch);
 
 	if (cold_boot) {
-		time_delta_off = sbi_scratch_alloc_offset(sizeof(*time_delta));
+		time_delta_off = sbi_scratch_alloc_class_offset(sizeof(*time_delta),
+					SBI_SCRATCH_ALLOC_LOCAL_HOT);
 		if (!time_delta_off)
 			return SBI_ENOMEM;
 
+		timer_hart_off = sbi_scratch_alloc_class_type_offset(
+					struct sbi_timer_hart,
+					SBI_SCRATCH_ALLOC_LOCAL_HOT);
+		if (!timer_hart_off)
+			return SBI_ENOMEM;
+
 		if (sbi_hart_has_extension(scratch, SBI_HART_EXT_ZICNTR))
 			get_time_val = get_ticks;
 	} else {
-		if (!time_delta_off)
+		if (!time_delta_off || !timer_hart_off)
 			return SBI_ENOMEM;
 	}
 
 	time_delta = sbi_scratch_offset_ptr(scratch, time_delta_off);
 	*time_delta = 0;
+	timer_hart_reset(scratch);
 
 	return sbi_platform_timer_init(plat, cold_boot);
 }
@@ -209,5 +423,8 @@ void sbi_timer_exit(struct sbi_scratch *scratch)
 	csr_clear(CSR_MIP, MIP_STIP);
 	csr_clear(CSR_MIE, MIP_MTIP);
 
+	/* Pending firmware events of a stopped HART are dropped */
+	timer_hart_reset(scratch);
+
 	sbi_platform_timer_exit(sbi_platform_ptr(scratch));
 }
@@ -215,12 +215,17 @@ static void tlb_pmu_incr_fw_ctr(struct sbi_tlb_info *data)
 static void tlb_entry_process(struct sbi_tlb_info *tinfo)
 {
 	u32 rindex;
+	unsigned long m;
 	struct sbi_scratch *rscratch = NULL;
 	atomic_t *rtlb_sync = NULL;
 
 	tinfo->local_fn(tinfo);
 
-	sbi_hartmask_for_each_hartindex(rindex, &tinfo->smask) {
+	for (rindex = tinfo->smask_base, m = tinfo->smask; m;
+	     rindex++, m >>= 1) {
+		if (!(m & 1UL))
+			continue;
+
 		rscratch = sbi_hartindex_to_scratch(rindex);
 		if (!rscratch)
 			continue;
@@ -233,11 +238,13 @@ static void tlb_entry_process(struct sbi_tlb_info *tinfo)
 static bool tlb_process_once(struct sbi_scratch *scratch)
 {
 	struct sbi_tlb_info tinfo;
+	unsigned long cycles = sbi_pmu_fw_cycles_begin();
 	struct sbi_fifo *tlb_fifo =
 			sbi_scratch_offset_ptr(scratch, tlb_fifo_off);
 
 	if (!sbi_fifo_dequeue(tlb_fifo, &tinfo)) {
 		tlb_entry_process(&tinfo);
+		sbi_pmu_fw_cycles_end(SBI_PMU_FW_CYCLES_RFENCE, cycles);
 		return true;
 	}
 
@@ -275,15 +282,19 @@ static inline int tlb_range_check(struct sbi_tlb_info *curr,
 	if (!curr || !next)
 		return ret;
 
+	/* Source HARTs must fit in the same source mask window */
+	if (curr->smask_base != next->smask_base)
+		return ret;
+
 	next_end = next->start + next->size;
 	curr_end = curr->start + curr->size;
 	if (next->start <= curr->start && next_end > curr_end) {
 		curr->start = next->start;
 		curr->size  = next->size;
-		sbi_hartmask_or(&curr->smask, &curr->smask, &next->smask);
+		curr->smask |= next->smask;
 		ret = SBI_FIFO_UPDATED;
 	} else if (next->start >= curr->start && next_end <= curr_end) {
-		sbi_hartmask_or(&curr->smask, &curr->smask, &next->smask);
+		curr->smask |= next->smask;
 		ret = SBI_FIFO_SKIP;
 	}
 
@@ -414,10 +425,12 @@ int sbi_tlb_init(struct sbi_scratch *scratch, bool cold_boot)
 	const struct sbi_platform *plat = sbi_platform_ptr(scratch);
 
 	if (cold_boot) {
-		tlb_sync_off = sbi_scratch_alloc_offset(sizeof(*tlb_sync));
+		tlb_sync_off = sbi_scratch_alloc_class_offset(sizeof(*tlb_sync),
+					SBI_SCRATCH_ALLOC_REMOTE_WRITTEN);
 		if (!tlb_sync_off)
 			return SBI_ENOMEM;
-		tlb_fifo_off = sbi_scratch_alloc_offset(sizeof(*tlb_q));
+		tlb_fifo_off = sbi_scratch_alloc_class_offset(sizeof(*tlb_q),
+					SBI_SCRATCH_ALLOC_REMOTE_WRITTEN);
 		if (!tlb_fifo_off) {
 			sbi_scratch_free_offset(tlb_sync_off);
 			return SBI_ENOMEM;
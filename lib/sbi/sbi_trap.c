@@ -267,6 +267,7 @@ struct sbi_trap_regs *sbi_trap_handler(struct sbi_trap_regs *regs)
 	ulong mcause = csr_read(CSR_MCAUSE);
 	ulong mtval = csr_read(CSR_MTVAL), mtval2 = 0, mtinst = 0;
 	struct sbi_trap_info trap;
+	unsigned long cycles;
 
 	if (misa_extension('H')) {
 		mtval2 = csr_read(CSR_MTVAL2);
@@ -288,20 +289,28 @@ struct sbi_trap_regs *sbi_trap_handler(struct sbi_trap_regs *regs)
 
 	switch (mcause) {
 	case CAUSE_ILLEGAL_INSTRUCTION:
+		cycles = sbi_pmu_fw_cycles_begin();
 		rc  = sbi_illegal_insn_handler(mtval, regs);
+		sbi_pmu_fw_cycles_end(SBI_PMU_FW_CYCLES_ILLEGAL_INSN, cycles);
 		msg = "illegal instruction handler failed";
 		break;
 	case CAUSE_MISALIGNED_LOAD:
+		cycles = sbi_pmu_fw_cycles_begin();
 		rc = sbi_misaligned_load_handler(mtval, mtval2, mtinst, regs);
+		sbi_pmu_fw_cycles_end(SBI_PMU_FW_CYCLES_MISALIGNED, cycles);
 		msg = "misaligned load handler failed";
 		break;
 	case CAUSE_MISALIGNED_STORE:
+		cycles = sbi_pmu_fw_cycles_begin();
 		rc  = sbi_misaligned_store_handler(mtval, mtval2, mtinst, regs);
+		sbi_pmu_fw_cycles_end(SBI_PMU_FW_CYCLES_MISALIGNED, cycles);
 		msg = "misaligned store handler failed";
 		break;
 	case CAUSE_SUPERVISOR_ECALL:
 	case CAUSE_MACHINE_ECALL:
+		cycles = sbi_pmu_fw_cycles_begin();
 		rc  = sbi_ecall_handler(regs);
+		sbi_pmu_fw_cycles_end(SBI_PMU_FW_CYCLES_ECALL, cycles);
 		msg = "ecall handler failed";
 		break;
 	case CAUSE_LOAD_ACCESS:
@@ -15,6 +15,7 @@
 #include <sbi/sbi_hartmask.h>
 #include <sbi/sbi_heap.h>
 #include <sbi/sbi_scratch.h>
+#include <sbi/sbi_string.h>
 #include <sbi_utils/fdt/fdt_domain.h>
 #include <sbi_utils/fdt/fdt_helper.h>
 
@@ -439,6 +440,13 @@ static int __fdt_parse_domain(void *fdt, int domain_offset, void *opaque)
 	else
 		dom->system_suspend_allowed = false;
 
+	/* Read "timer-slack-us" DT property */
+	val = fdt_getprop(fdt, domain_offset, "timer-slack-us", &len);
+	if (val && len >= 4)
+		dom->timer_slack_us = fdt32_to_cpu(val[0]);
+	else
+		dom->timer_slack_us = 0;
+
 	/* Find /cpus DT node */
 	cpus_offset = fdt_path_offset(fdt, "/cpus");
 	if (cpus_offset < 0) {
@@ -491,12 +499,65 @@ fail_free_domain:
 	return err;
 }
 
+/* Domain instance DT node names are unique under the config DT node */
+static struct sbi_domain *fdt_domain_find(void *fdt, int domain_offset)
+{
+	const char *name = fdt_get_name(fdt, domain_offset, NULL);
+	struct sbi_domain *dom;
+	u32 i;
+
+	if (!name)
+		return NULL;
+
+	sbi_domain_for_each(i, dom) {
+		if (dom != &root &&
+		    !sbi_strncmp(dom->name, name, sizeof(dom->name) - 1))
+			return dom;
+	}
+
+	return NULL;
+}
+
+static int fdt_domain_parse_enter(void *fdt, int offset, const char *prop,
+				  struct sbi_domain *dom)
+{
+	struct sbi_domain *target;
+	const u32 *val;
+	int i, len, doffset;
+
+	val = fdt_getprop(fdt, offset, prop, &len);
+	len = (val) ? len / sizeof(u32) : 0;
+	for (i = 0; i < len; i++) {
+		doffset = fdt_node_offset_by_phandle(fdt, fdt32_to_cpu(val[i]));
+		if (doffset < 0)
+			return doffset;
+
+		target = fdt_domain_find(fdt, doffset);
+		if (!target)
+			return SBI_EINVAL;
+		dom->enter_domains |= 1U << target->index;
+	}
+
+	return 0;
+}
+
+static int __fdt_parse_domain_enter(void *fdt, int domain_offset,
+				    void *opaque)
+{
+	struct sbi_domain *dom = fdt_domain_find(fdt, domain_offset);
+
+	if (!dom)
+		return SBI_EINVAL;
+
+	return fdt_domain_parse_enter(fdt, domain_offset, "enter-domains", dom);
+}
+
 int fdt_domains_populate(void *fdt)
 {
 	const u32 *val;
 	int cold_domain_offset;
 	u32 hartid, cold_hartid;
-	int err, len, cpus_offset, cpu_offset;
+	int err, len, cpus_offset, cpu_offset, poffset;
 
 	/* Sanity checks */
 	if (!fdt)
@@ -530,6 +591,23 @@ int fdt_domains_populate(void *fdt)
 	}
 
 	/* Iterate over each domain in FDT and populate details */
-	return fdt_iterate_each_domain(fdt, &cold_domain_offset,
-				       __fdt_parse_domain);
+	err = fdt_iterate_each_domain(fdt, &cold_domain_offset,
+				      __fdt_parse_domain);
+	if (err)
+		return err;
+
+	/* Domains to enter can only be resolved once all are registered */
+	err = fdt_iterate_each_domain(fdt, NULL, __fdt_parse_domain_enter);
+	if (err)
+		return err;
+
+	/* The ROOT domain has no domain instance DT node */
+	poffset = fdt_path_offset(fdt, "/chosen");
+	if (poffset >= 0)
+		poffset = fdt_node_offset_by_compatible(fdt, poffset,
+						"opensbi,domain,config");
+	if (poffset < 0)
+		return 0;
+
+	return fdt_domain_parse_enter(fdt, poffset, "root-enter-domains", &root);
 }
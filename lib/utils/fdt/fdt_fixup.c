@@ -16,6 +16,7 @@
 #include <sbi/sbi_scratch.h>
 #include <sbi/sbi_string.h>
 #include <sbi/sbi_error.h>
+#include <sbi/sbi_timer.h>
 #include <sbi_utils/fdt/fdt_fixup.h>
 #include <sbi_utils/fdt/fdt_pmu.h>
 #include <sbi_utils/fdt/fdt_helper.h>
@@ -385,6 +386,34 @@ int fdt_reserved_memory_fixup(void *fdt)
 	return 0;
 }
 
+int fdt_timer_fixup(void *fdt)
+{
+	int err, coff;
+	struct sbi_domain *dom = sbi_domain_thishart_ptr();
+	const struct sbi_timer_device *tdev = sbi_timer_get_device();
+
+	if (!tdev || !tdev->smode_time_addr)
+		return 0;
+
+	if (!sbi_domain_check_addr(dom, tdev->smode_time_addr,
+				   dom->next_mode, SBI_DOMAIN_READ))
+		return 0;
+
+	err = fdt_open_into(fdt, fdt, fdt_totalsize(fdt) + 64);
+	if (err < 0)
+		return err;
+
+	coff = fdt_path_offset(fdt, "/chosen");
+	if (coff < 0) {
+		coff = fdt_add_subnode(fdt, 0, "chosen");
+		if (coff < 0)
+			return coff;
+	}
+
+	return fdt_setprop_u64(fdt, coff, "opensbi,mtime",
+			       tdev->smode_time_addr);
+}
+
 void fdt_fixups(void *fdt)
 {
 	fdt_aplic_fixup(fdt);
@@ -395,4 +424,6 @@ void fdt_fixups(void *fdt)
 
 	fdt_reserved_memory_fixup(fdt);
 	fdt_pmu_fixup(fdt);
+
+	fdt_timer_fixup(fdt);
 }
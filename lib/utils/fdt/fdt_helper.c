@@ -376,6 +376,8 @@ static int fdt_parse_isa_one_hart(const char *isa, unsigned long *extensions)
 			}
 
 		set_multi_letter_ext("smepmp", SBI_HART_EXT_SMEPMP);
+		set_multi_letter_ext("smcdeleg", SBI_HART_EXT_SMCDELEG);
+		set_multi_letter_ext("ssccfg", SBI_HART_EXT_SSCCFG);
 #undef set_multi_letter_ext
 	}
 
@@ -454,14 +456,69 @@ int fdt_parse_isa_extensions(void *fdt, unsigned int hartid,
 	return 0;
 }
 
+static int fdt_parse_irq_parent(void *fdt, int nodeoffset)
+{
+	const fdt32_t *val;
+	int len;
+
+	while (nodeoffset >= 0) {
+		val = fdt_getprop(fdt, nodeoffset, "interrupt-parent", &len);
+		if (val && len >= sizeof(fdt32_t))
+			return fdt_node_offset_by_phandle(fdt,
+							  fdt32_to_cpu(*val));
+		nodeoffset = fdt_parent_offset(fdt, nodeoffset);
+	}
+
+	return -FDT_ERR_NOTFOUND;
+}
+
+/*
+ * Parse the first wired interrupt of a device node along with the MMIO
+ * base address of the interrupt controller it is wired to.
+ */
+static int fdt_parse_wired_irq(void *fdt, int nodeoffset, u32 *hwirq,
+			       uint64_t *parent_addr)
+{
+	const fdt32_t *val, *cells;
+	int len, clen, pnodeoffset;
+
+	val = fdt_getprop(fdt, nodeoffset, "interrupts-extended", &len);
+	if (val && len >= 2 * sizeof(fdt32_t)) {
+		pnodeoffset = fdt_node_offset_by_phandle(fdt,
+							 fdt32_to_cpu(*val));
+		val++;
+		len -= sizeof(fdt32_t);
+	} else {
+		val = fdt_getprop(fdt, nodeoffset, "interrupts", &len);
+		if (!val || len < sizeof(fdt32_t))
+			return SBI_ENOENT;
+		pnodeoffset = fdt_parse_irq_parent(fdt, nodeoffset);
+	}
+	if (pnodeoffset < 0)
+		return SBI_ENODEV;
+
+	cells = fdt_getprop(fdt, pnodeoffset, "#interrupt-cells", &clen);
+	if (!cells || clen < sizeof(fdt32_t) || !fdt32_to_cpu(*cells) ||
+	    len < fdt32_to_cpu(*cells) * sizeof(fdt32_t))
+		return SBI_EINVAL;
+
+	if (fdt_get_node_addr_size(fdt, pnodeoffset, 0, parent_addr, NULL))
+		return SBI_ENODEV;
+
+	*hwirq = fdt32_to_cpu(*val);
+
+	return 0;
+}
+
 static int fdt_parse_uart_node_common(void *fdt, int nodeoffset,
 				      struct platform_uart_data *uart,
 				      unsigned long default_freq,
 				      unsigned long default_baud)
 {
 	int len, rc;
+	u32 irq;
 	const fdt32_t *val;
-	uint64_t reg_addr, reg_size;
+	uint64_t reg_addr, reg_size, irq_parent_addr;
 
 	if (nodeoffset < 0 || !uart || !fdt)
 		return SBI_ENODEV;
@@ -488,6 +545,22 @@ static int fdt_parse_uart_node_common(void *fdt, int nodeoffset,
 	else
 		uart->baud = default_baud;
 
+	/* TX FIFO depth is optional, zero lets the driver decide */
+	val = (fdt32_t *)fdt_getprop(fdt, nodeoffset, "fifo-size", &len);
+	if (len > 0 && val)
+		uart->fifo_size = fdt32_to_cpu(*val);
+	else
+		uart->fifo_size = 0;
+
+	/* Wired interrupt is optional, zero means input is polled */
+	if (!fdt_parse_wired_irq(fdt, nodeoffset, &irq, &irq_parent_addr)) {
+		uart->irq = irq;
+		uart->irq_parent_addr = irq_parent_addr;
+	} else {
+		uart->irq = 0;
+		uart->irq_parent_addr = 0;
+	}
+
 	return 0;
 }
 
@@ -22,23 +22,46 @@ struct fdt_pmu_hw_event_select {
 	uint64_t select;
 };
 
+/* Event selector values sorted by event index */
 static struct fdt_pmu_hw_event_select fdt_pmu_evt_select[FDT_PMU_HW_EVENT_MAX] = {0};
 static uint32_t hw_event_count;
 
 uint64_t fdt_pmu_get_select_value(uint32_t event_idx)
 {
-	int i;
-	struct fdt_pmu_hw_event_select *event;
-
-	for (i = 0; i < SBI_PMU_HW_EVENT_MAX; i++) {
-		event = &fdt_pmu_evt_select[i];
-		if (event->eidx == event_idx)
-			return event->select;
+	uint32_t lo = 0, hi = hw_event_count, mid;
+
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		if (fdt_pmu_evt_select[mid].eidx < event_idx)
+			lo = mid + 1;
+		else
+			hi = mid;
 	}
 
+	if (lo < hw_event_count && fdt_pmu_evt_select[lo].eidx == event_idx)
+		return fdt_pmu_evt_select[lo].select;
+
 	return 0;
 }
 
+static void fdt_pmu_add_select_value(uint32_t eidx, uint64_t select)
+{
+	uint32_t pos = hw_event_count;
+
+	/*
+	 * Insert after existing entries with the same event index so
+	 * that the first entry in the DT takes precedence.
+	 */
+	while (pos > 0 && fdt_pmu_evt_select[pos - 1].eidx > eidx) {
+		fdt_pmu_evt_select[pos] = fdt_pmu_evt_select[pos - 1];
+		pos--;
+	}
+
+	fdt_pmu_evt_select[pos].eidx = eidx;
+	fdt_pmu_evt_select[pos].select = select;
+	hw_event_count++;
+}
+
 int fdt_pmu_fixup(void *fdt)
 {
 	int pmu_offset;
@@ -51,9 +74,17 @@ int fdt_pmu_fixup(void *fdt)
 	if (pmu_offset < 0)
 		return SBI_EFAIL;
 
-	fdt_delprop(fdt, pmu_offset, "riscv,event-to-mhpmcounters");
-	fdt_delprop(fdt, pmu_offset, "riscv,event-to-mhpmevent");
-	fdt_delprop(fdt, pmu_offset, "riscv,raw-event-to-mhpmcounters");
+	/*
+	 * With counter delegation, S-mode programs the event selectors
+	 * itself so it needs the event mappings. Otherwise they are only
+	 * meaningful to the SBI implementation.
+	 */
+	if (!sbi_pmu_hw_ctr_delegated_mask(scratch)) {
+		fdt_delprop(fdt, pmu_offset, "riscv,event-to-mhpmcounters");
+		fdt_delprop(fdt, pmu_offset, "riscv,event-to-mhpmevent");
+		fdt_delprop(fdt, pmu_offset,
+			    "riscv,raw-event-to-mhpmcounters");
+	}
 	if (!sbi_hart_has_extension(scratch, SBI_HART_EXT_SSCOFPMF))
 		fdt_delprop(fdt, pmu_offset, "interrupts-extended");
 
@@ -65,8 +96,7 @@ int fdt_pmu_setup(void *fdt)
 	int i, pmu_offset, len, result;
 	const u32 *event_val;
 	const u32 *event_ctr_map;
-	struct fdt_pmu_hw_event_select *event;
-	uint64_t raw_selector, select_mask;
+	uint64_t raw_selector, select_mask, select_val;
 	u32 event_idx_start, event_idx_end, ctr_map;
 
 	if (!fdt)
@@ -96,12 +126,13 @@ int fdt_pmu_setup(void *fdt)
 	if (event_val && len >= 8) {
 		len = len / (sizeof(u32) * 3);
 		for (i = 0; i < len; i++) {
-			event = &fdt_pmu_evt_select[hw_event_count];
-			event->eidx = fdt32_to_cpu(event_val[3 * i]);
-			event->select = fdt32_to_cpu(event_val[3 * i + 1]);
-			event->select = (event->select << 32) |
-					fdt32_to_cpu(event_val[3 * i + 2]);
-			hw_event_count++;
+			if (hw_event_count >= FDT_PMU_HW_EVENT_MAX)
+				return SBI_ENOSPC;
+			event_idx_start = fdt32_to_cpu(event_val[3 * i]);
+			select_val = fdt32_to_cpu(event_val[3 * i + 1]);
+			select_val = (select_val << 32) |
+				     fdt32_to_cpu(event_val[3 * i + 2]);
+			fdt_pmu_add_select_value(event_idx_start, select_val);
 		}
 	}
 
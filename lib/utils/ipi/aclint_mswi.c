@@ -17,52 +17,28 @@
 #include <sbi/sbi_timer.h>
 #include <sbi_utils/ipi/aclint_mswi.h>
 
-static unsigned long mswi_ptr_offset;
-
-#define mswi_get_hart_data_ptr(__scratch)				\
-	sbi_scratch_read_type((__scratch), void *, mswi_ptr_offset)
-
-#define mswi_set_hart_data_ptr(__scratch, __mswi)			\
-	sbi_scratch_write_type((__scratch), void *, mswi_ptr_offset, (__mswi))
-
 static void mswi_ipi_send(u32 hart_index)
 {
-	u32 *msip;
 	struct sbi_scratch *scratch;
-	struct aclint_mswi_data *mswi;
 
 	scratch = sbi_hartindex_to_scratch(hart_index);
-	if (!scratch)
-		return;
-
-	mswi = mswi_get_hart_data_ptr(scratch);
-	if (!mswi)
+	if (!scratch || !scratch->hot.msip_addr)
 		return;
 
 	/* Set ACLINT IPI */
-	msip = (void *)mswi->addr;
-	writel(1, &msip[sbi_hartindex_to_hartid(hart_index) -
-			mswi->first_hartid]);
+	writel(1, (void *)scratch->hot.msip_addr);
 }
 
 static void mswi_ipi_clear(u32 hart_index)
 {
-	u32 *msip;
 	struct sbi_scratch *scratch;
-	struct aclint_mswi_data *mswi;
 
 	scratch = sbi_hartindex_to_scratch(hart_index);
-	if (!scratch)
-		return;
-
-	mswi = mswi_get_hart_data_ptr(scratch);
-	if (!mswi)
+	if (!scratch || !scratch->hot.msip_addr)
 		return;
 
 	/* Clear ACLINT IPI */
-	msip = (void *)mswi->addr;
-	writel(0, &msip[sbi_hartindex_to_hartid(hart_index) -
-			mswi->first_hartid]);
+	writel(0, (void *)scratch->hot.msip_addr);
 }
 
 static struct sbi_ipi_device aclint_mswi = {
@@ -74,7 +50,7 @@ static struct sbi_ipi_device aclint_mswi = {
 int aclint_mswi_warm_init(void)
 {
 	/* Clear IPI for current HART */
-	mswi_ipi_clear(current_hartid());
+	mswi_ipi_clear(current_hartindex());
 
 	return 0;
 }
@@ -93,14 +69,7 @@ int aclint_mswi_cold_init(struct aclint_mswi_data *mswi)
 	    (!mswi->hart_count || mswi->hart_count > ACLINT_MSWI_MAX_HARTS))
 		return SBI_EINVAL;
 
-	/* Allocate scratch space pointer */
-	if (!mswi_ptr_offset) {
-		mswi_ptr_offset = sbi_scratch_alloc_type_offset(void *);
-		if (!mswi_ptr_offset)
-			return SBI_ENOMEM;
-	}
-
-	/* Update MSWI pointer in scratch space */
+	/* Update MSIP address in the hot context of each HART */
 	for (i = 0; i < mswi->hart_count; i++) {
 		scratch = sbi_hartid_to_scratch(mswi->first_hartid + i);
 		/*
@@ -110,7 +79,7 @@ int aclint_mswi_cold_init(struct aclint_mswi_data *mswi)
 		 */
 		if (!scratch)
 			continue;
-		mswi_set_hart_data_ptr(scratch, mswi);
+		scratch->hot.msip_addr = mswi->addr + i * sizeof(u32);
 	}
 
 	/* Add MSWI regions to the root domain */
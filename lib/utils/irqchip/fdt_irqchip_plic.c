@@ -12,6 +12,7 @@
 #include <sbi/riscv_io.h>
 #include <sbi/sbi_error.h>
 #include <sbi/sbi_heap.h>
+#include <sbi/sbi_irqchip.h>
 #include <sbi/sbi_scratch.h>
 #include <sbi_utils/fdt/fdt_helper.h>
 #include <sbi_utils/irqchip/fdt_irqchip.h>
@@ -85,6 +86,44 @@ static int irqchip_plic_warm_init(void)
 				      plic_get_hart_scontext(scratch));
 }
 
+static int irqchip_plic_hwirq_route(unsigned long parent_addr, u32 hwirq,
+				    bool enable)
+{
+	struct sbi_scratch *scratch = sbi_scratch_thishart_ptr();
+	struct plic_data *plic = plic_get_hart_data_ptr(scratch);
+
+	/* Only interrupts wired to the PLIC serving this HART */
+	if (!plic || plic->addr != parent_addr ||
+	    plic_get_hart_mcontext(scratch) < 0)
+		return SBI_ENODEV;
+
+	return plic_context_route_irq(plic, plic_get_hart_mcontext(scratch),
+				      hwirq, enable);
+}
+
+static u32 irqchip_plic_hwirq_claim(void)
+{
+	struct sbi_scratch *scratch = sbi_scratch_thishart_ptr();
+
+	return plic_context_claim(plic_get_hart_data_ptr(scratch),
+				  plic_get_hart_mcontext(scratch));
+}
+
+static void irqchip_plic_hwirq_complete(u32 hwirq)
+{
+	struct sbi_scratch *scratch = sbi_scratch_thishart_ptr();
+
+	plic_context_complete(plic_get_hart_data_ptr(scratch),
+			      plic_get_hart_mcontext(scratch), hwirq);
+}
+
+static struct sbi_irqchip_device plic_irqchip = {
+	.name = "plic",
+	.hwirq_route = irqchip_plic_hwirq_route,
+	.hwirq_claim = irqchip_plic_hwirq_claim,
+	.hwirq_complete = irqchip_plic_hwirq_complete,
+};
+
 static int irqchip_plic_update_hartid_table(void *fdt, int nodeoff,
 					    struct plic_data *pd)
 {
@@ -177,6 +216,8 @@ static int irqchip_plic_cold_init(void *fdt, int nodeoff,
 	if (rc)
 		goto fail_free_data;
 
+	sbi_irqchip_set_device(&plic_irqchip);
+
 	return 0;
 
 fail_free_data:
@@ -10,6 +10,7 @@
 
 #include <sbi/riscv_io.h>
 #include <sbi/riscv_encoding.h>
+#include <sbi/sbi_bitops.h>
 #include <sbi/sbi_console.h>
 #include <sbi/sbi_error.h>
 #include <sbi/sbi_string.h>
@@ -21,6 +22,7 @@
 #define PLIC_ENABLE_STRIDE 0x80
 #define PLIC_CONTEXT_BASE 0x200000
 #define PLIC_CONTEXT_STRIDE 0x1000
+#define PLIC_CONTEXT_CLAIM 0x4
 
 static u32 plic_get_priority(const struct plic_data *plic, u32 source)
 {
@@ -119,6 +121,52 @@ void plic_context_restore(const struct plic_data *plic, int context_id,
 	plic_set_thresh(plic, context_id, threshold);
 }
 
+int plic_context_route_irq(const struct plic_data *plic, int context_id,
+			   u32 hwirq, bool enable)
+{
+	u32 ie;
+
+	if (!plic || context_id < 0)
+		return SBI_EINVAL;
+	if (!hwirq || hwirq > plic->num_src)
+		return SBI_EINVAL;
+
+	ie = plic_get_ie(plic, context_id, hwirq / 32);
+	if (enable)
+		ie |= BIT(hwirq % 32);
+	else
+		ie &= ~BIT(hwirq % 32);
+	plic_set_ie(plic, context_id, hwirq / 32, ie);
+
+	if (enable) {
+		plic_set_priority(plic, hwirq, 1);
+		plic_set_thresh(plic, context_id, 0);
+	}
+
+	return 0;
+}
+
+u32 plic_context_claim(const struct plic_data *plic, int context_id)
+{
+	volatile void *plic_claim;
+
+	plic_claim = (char *)plic->addr + PLIC_CONTEXT_BASE +
+		     PLIC_CONTEXT_STRIDE * context_id + PLIC_CONTEXT_CLAIM;
+
+	return readl(plic_claim);
+}
+
+void plic_context_complete(const struct plic_data *plic, int context_id,
+			   u32 hwirq)
+{
+	volatile void *plic_claim;
+
+	plic_claim = (char *)plic->addr + PLIC_CONTEXT_BASE +
+		     PLIC_CONTEXT_STRIDE * context_id + PLIC_CONTEXT_CLAIM;
+
+	writel(hwirq, plic_claim);
+}
+
 int plic_context_init(const struct plic_data *plic, int context_id,
 		      bool enable, u32 threshold)
 {
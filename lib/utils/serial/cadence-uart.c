@@ -34,13 +34,17 @@
 #define UART_BRGR_CD_CLKDIVISOR	0x00000001	/* baud_sample = sel_clk */
 
 #define	UART_CSR_REMPTY		0x00000002
+#define	UART_CSR_TEMPTY		0x00000008
 #define	UART_CSR_TFUL		0x00000010
 
+#define UART_TX_FIFO_SIZE	64
+
 /* clang-format on */
 
 static volatile void *uart_base;
 static u32 uart_in_freq;
 static u32 uart_baudrate;
+static u32 uart_fifo_size = UART_TX_FIFO_SIZE;
 
 /*
  * Find minimum divisor divides in_freq to max_target_hz;
@@ -76,6 +80,24 @@ static void cadence_uart_putc(char ch)
 	set_reg(UART_REG_RFIFO_TFIFO, ch);
 }
 
+static void cadence_uart_wait_tx_empty(void)
+{
+	while (!(get_reg(UART_REG_CSR) & UART_CSR_TEMPTY))
+		;
+}
+
+static void cadence_uart_write_tx(char ch)
+{
+	set_reg(UART_REG_RFIFO_TFIFO, ch);
+}
+
+static unsigned long cadence_uart_puts(const char *str, unsigned long len)
+{
+	return sbi_console_puts_fifo(str, len, uart_fifo_size,
+				     cadence_uart_wait_tx_empty,
+				     cadence_uart_write_tx);
+}
+
 static int cadence_uart_getc(void)
 {
 	u32 ret = get_reg(UART_REG_CSR);
@@ -89,9 +111,17 @@ static int cadence_uart_getc(void)
 static struct sbi_console_device cadence_console = {
 	.name = "cadence_uart",
 	.console_putc = cadence_uart_putc,
+	.console_puts = cadence_uart_puts,
 	.console_getc = cadence_uart_getc
 };
 
+void cadence_uart_set_fifo_size(u32 fifo_size)
+{
+	/* Bulk writes need room for at least a "\r\n" pair */
+	if (fifo_size > 1)
+		uart_fifo_size = fifo_size;
+}
+
 int cadence_uart_init(unsigned long base, u32 in_freq, u32 baudrate)
 {
 	uart_base     = (volatile void *)base;
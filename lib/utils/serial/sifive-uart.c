@@ -25,7 +25,11 @@
 #define UART_RXFIFO_EMPTY	0x80000000
 #define UART_RXFIFO_DATA	0x000000ff
 #define UART_TXCTRL_TXEN	0x1
+#define UART_TXCTRL_TXCNT_SHIFT	16
 #define UART_RXCTRL_RXEN	0x1
+#define UART_IP_TXWM		0x1
+
+#define UART_TX_FIFO_SIZE	8
 
 /* clang-format on */
 
@@ -74,6 +78,25 @@ static void sifive_uart_putc(char ch)
 	set_reg(UART_REG_TXFIFO, ch);
 }
 
+/* TX watermark of one is pending only when the TX FIFO is empty */
+static void sifive_uart_wait_tx_empty(void)
+{
+	while (!(get_reg(UART_REG_IP) & UART_IP_TXWM))
+		;
+}
+
+static void sifive_uart_write_tx(char ch)
+{
+	set_reg(UART_REG_TXFIFO, ch);
+}
+
+static unsigned long sifive_uart_puts(const char *str, unsigned long len)
+{
+	return sbi_console_puts_fifo(str, len, UART_TX_FIFO_SIZE,
+				     sifive_uart_wait_tx_empty,
+				     sifive_uart_write_tx);
+}
+
 static int sifive_uart_getc(void)
 {
 	u32 ret = get_reg(UART_REG_RXFIFO);
@@ -87,6 +110,7 @@ static int sifive_uart_getc(void)
 static struct sbi_console_device sifive_console = {
 	.name = "sifive_uart",
 	.console_putc = sifive_uart_putc,
+	.console_puts = sifive_uart_puts,
 	.console_getc = sifive_uart_getc
 };
 
@@ -103,8 +127,9 @@ int sifive_uart_init(unsigned long base, u32 in_freq, u32 baudrate)
 	/* Disable interrupts */
 	set_reg(UART_REG_IE, 0);
 
-	/* Enable TX */
-	set_reg(UART_REG_TXCTRL, UART_TXCTRL_TXEN);
+	/* Enable TX with watermark interrupt pending on empty TX FIFO */
+	set_reg(UART_REG_TXCTRL,
+		UART_TXCTRL_TXEN | (1 << UART_TXCTRL_TXCNT_SHIFT));
 
 	/* Enable Rx */
 	set_reg(UART_REG_RXCTRL, UART_RXCTRL_RXEN);
@@ -39,6 +39,14 @@
 #define UART_LSR_DR		0x01	/* Receiver data ready */
 #define UART_LSR_BRK_ERROR_BITS	0x1E	/* BI, FE, PE, OE bits */
 
+#define UART_IER_RDI		0x01	/* Receiver data interrupt */
+
+#define UART_MCR_OUT2		0x08	/* Interrupt output enable */
+
+#define UART_IIR_FIFO_MASK	0xC0	/* FIFOs enabled (16550A and later) */
+
+#define UART_FIFO_SIZE_16550A	16
+
 /* clang-format on */
 
 static volatile char *uart8250_base;
@@ -46,6 +54,7 @@ static u32 uart8250_in_freq;
 static u32 uart8250_baudrate;
 static u32 uart8250_reg_width;
 static u32 uart8250_reg_shift;
+static u32 uart8250_fifo_size;
 
 static u32 get_reg(u32 num)
 {
@@ -79,6 +88,24 @@ static void uart8250_putc(char ch)
 	set_reg(UART_THR_OFFSET, ch);
 }
 
+/* THRE means the whole TX FIFO is empty */
+static void uart8250_wait_tx_empty(void)
+{
+	while ((get_reg(UART_LSR_OFFSET) & UART_LSR_THRE) == 0)
+		;
+}
+
+static void uart8250_write_tx(char ch)
+{
+	set_reg(UART_THR_OFFSET, ch);
+}
+
+static unsigned long uart8250_puts(const char *str, unsigned long len)
+{
+	return sbi_console_puts_fifo(str, len, uart8250_fifo_size,
+				     uart8250_wait_tx_empty, uart8250_write_tx);
+}
+
 static int uart8250_getc(void)
 {
 	if (get_reg(UART_LSR_OFFSET) & UART_LSR_DR)
@@ -92,6 +119,28 @@ static struct sbi_console_device uart8250_console = {
 	.console_getc = uart8250_getc
 };
 
+void uart8250_set_fifo_size(u32 fifo_size)
+{
+	if (fifo_size)
+		uart8250_fifo_size = fifo_size;
+
+	/* Bulk writes need room for at least a "\r\n" pair */
+	uart8250_console.console_puts =
+		(uart8250_fifo_size > 1) ? uart8250_puts : NULL;
+}
+
+static void uart8250_rx_enable(void)
+{
+	set_reg(UART_MCR_OFFSET, get_reg(UART_MCR_OFFSET) | UART_MCR_OUT2);
+	set_reg(UART_IER_OFFSET, UART_IER_RDI);
+}
+
+int uart8250_set_rx_hwirq(u32 hwirq, unsigned long parent_addr)
+{
+	return sbi_console_set_rx_hwirq(hwirq, parent_addr,
+					uart8250_rx_enable);
+}
+
 int uart8250_init(unsigned long base, u32 in_freq, u32 baudrate, u32 reg_shift,
 		  u32 reg_width, u32 reg_offset)
 {
@@ -124,6 +173,13 @@ int uart8250_init(unsigned long base, u32 in_freq, u32 baudrate, u32 reg_shift,
 	set_reg(UART_LCR_OFFSET, 0x03);
 	/* Enable FIFO */
 	set_reg(UART_FCR_OFFSET, 0x01);
+	/* Probe for a working TX FIFO */
+	if ((get_reg(UART_IIR_OFFSET) & UART_IIR_FIFO_MASK) ==
+	    UART_IIR_FIFO_MASK)
+		uart8250_fifo_size = UART_FIFO_SIZE_16550A;
+	else
+		uart8250_fifo_size = 1;
+	uart8250_set_fifo_size(0);
 	/* No modem control DTR RTS */
 	set_reg(UART_MCR_OFFSET, 0x00);
 	/* Clear line status */
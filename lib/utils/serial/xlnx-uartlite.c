@@ -29,6 +29,8 @@
 # define UART_CTRL_RST_RX	0x02
 # define UART_CTRL_IE		0x10
 
+#define UART_TX_FIFO_SIZE	16
+
 /* clang-format on */
 
 static volatile char *xlnx_uartlite_base;
@@ -41,6 +43,25 @@ static void xlnx_uartlite_putc(char ch)
 	writeb(ch, xlnx_uartlite_base + UART_TX_OFFSET);
 }
 
+static void xlnx_uartlite_wait_tx_empty(void)
+{
+	while (!(readb(xlnx_uartlite_base + UART_STATUS_OFFSET) &
+		 UART_STATUS_TXEMPTY))
+		;
+}
+
+static void xlnx_uartlite_write_tx(char ch)
+{
+	writeb(ch, xlnx_uartlite_base + UART_TX_OFFSET);
+}
+
+static unsigned long xlnx_uartlite_puts(const char *str, unsigned long len)
+{
+	return sbi_console_puts_fifo(str, len, UART_TX_FIFO_SIZE,
+				     xlnx_uartlite_wait_tx_empty,
+				     xlnx_uartlite_write_tx);
+}
+
 static int xlnx_uartlite_getc(void)
 {
 	u16 status = readb(xlnx_uartlite_base + UART_STATUS_OFFSET);
@@ -54,6 +75,7 @@ static int xlnx_uartlite_getc(void)
 static struct sbi_console_device xlnx_uartlite_console = {
 	.name = "xlnx-uartlite",
 	.console_putc = xlnx_uartlite_putc,
+	.console_puts = xlnx_uartlite_puts,
 	.console_getc = xlnx_uartlite_getc
 };
 
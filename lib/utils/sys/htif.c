@@ -5,6 +5,7 @@
  * (Regents).  All Rights Reserved.
  */
 
+#include <sbi/riscv_barrier.h>
 #include <sbi/riscv_locks.h>
 #include <sbi/sbi_console.h>
 #include <sbi/sbi_error.h>
@@ -46,6 +47,8 @@
 
 #define PK_SYS_write 64
 
+#define HTIF_PUTS_BUF_SIZE	256
+
 volatile uint64_t tohost __attribute__((section(".htif")));
 volatile uint64_t fromhost __attribute__((section(".htif")));
 
@@ -56,6 +59,12 @@ static bool htif_custom = false;
 static int htif_console_buf;
 static spinlock_t htif_lock = SPIN_LOCK_INITIALIZER;
 
+#ifdef CONFIG_SYS_HTIF_CONSOLE_BATCH
+/* Proxied write syscall used for batched console output */
+static volatile uint64_t htif_magic_mem[8] __aligned(64);
+static char htif_puts_buf[HTIF_PUTS_BUF_SIZE] __aligned(64);
+#endif
+
 static inline uint64_t __read_tohost(void)
 {
 	return (htif_custom) ? *htif_tohost : tohost;
@@ -127,11 +136,9 @@ static int set_custom_addr(bool custom_addr,
 	return 0;
 }
 
-#if __riscv_xlen == 32
-static void do_tohost_fromhost(uint64_t dev, uint64_t cmd, uint64_t data)
+#if __riscv_xlen == 32 || defined(CONFIG_SYS_HTIF_CONSOLE_BATCH)
+static void __do_tohost_fromhost(uint64_t dev, uint64_t cmd, uint64_t data)
 {
-	spin_lock(&htif_lock);
-
 	__set_tohost(HTIF_DEV_SYSTEM, cmd, data);
 
 	while (1) {
@@ -145,7 +152,48 @@ static void do_tohost_fromhost(uint64_t dev, uint64_t cmd, uint64_t data)
 			__check_fromhost();
 		}
 	}
+}
+#endif
+
+#ifdef CONFIG_SYS_HTIF_CONSOLE_BATCH
+/* Proxy a write syscall to the host, htif_lock must be held */
+static void __htif_sys_write(const char *buf, unsigned long len)
+{
+	htif_magic_mem[0] = PK_SYS_write;
+	htif_magic_mem[1] = HTIF_DEV_CONSOLE;
+	htif_magic_mem[2] = (uint64_t)(uintptr_t)buf;
+	htif_magic_mem[3] = len;
+
+	/* Host reads the syscall block and buffer from memory */
+	wmb();
+	__do_tohost_fromhost(HTIF_DEV_SYSTEM, 0,
+			     (uint64_t)(uintptr_t)htif_magic_mem);
+}
+
+static unsigned long htif_puts(const char *str, unsigned long len)
+{
+	unsigned long i = 0, n = 0;
+
+	spin_lock(&htif_lock);
+
+	while (i < len && n < HTIF_PUTS_BUF_SIZE - 1) {
+		if (str[i] == '\n')
+			htif_puts_buf[n++] = '\r';
+		htif_puts_buf[n++] = str[i++];
+	}
+	__htif_sys_write(htif_puts_buf, n);
+
+	spin_unlock(&htif_lock);
+
+	return i;
+}
+#endif
 
+#if __riscv_xlen == 32
+static void do_tohost_fromhost(uint64_t dev, uint64_t cmd, uint64_t data)
+{
+	spin_lock(&htif_lock);
+	__do_tohost_fromhost(dev, cmd, data);
 	spin_unlock(&htif_lock);
 }
 
@@ -194,6 +242,9 @@ static int htif_getc(void)
 static struct sbi_console_device htif_console = {
 	.name = "htif",
 	.console_putc = htif_putc,
+#ifdef CONFIG_SYS_HTIF_CONSOLE_BATCH
+	.console_puts = htif_puts,
+#endif
 	.console_getc = htif_getc
 };
 
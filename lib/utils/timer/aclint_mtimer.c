@@ -11,8 +11,11 @@
 #include <sbi/riscv_atomic.h>
 #include <sbi/riscv_io.h>
 #include <sbi/sbi_bitops.h>
+#include <sbi/sbi_console.h>
 #include <sbi/sbi_domain.h>
 #include <sbi/sbi_error.h>
+#include <sbi/sbi_hart.h>
+#include <sbi/sbi_math.h>
 #include <sbi/sbi_scratch.h>
 #include <sbi/sbi_timer.h>
 #include <sbi_utils/timer/aclint_mtimer.h>
@@ -71,43 +74,28 @@ static u64 mtimer_value(void)
 
 static void mtimer_event_stop(void)
 {
-	u32 target_hart = current_hartid();
-	struct sbi_scratch *scratch;
+	struct sbi_scratch *scratch = sbi_scratch_thishart_ptr();
 	struct aclint_mtimer_data *mt;
-	u64 *time_cmp;
-
-	scratch = sbi_hartid_to_scratch(target_hart);
-	if (!scratch)
-		return;
 
 	mt = mtimer_get_hart_data_ptr(scratch);
-	if (!mt)
+	if (!mt || !scratch->hot.timecmp_addr)
 		return;
 
 	/* Clear MTIMER Time Compare */
-	time_cmp = (void *)mt->mtimecmp_addr;
-	mt->time_wr(true, -1ULL, &time_cmp[target_hart - mt->first_hartid]);
+	mt->time_wr(true, -1ULL, (void *)scratch->hot.timecmp_addr);
 }
 
 static void mtimer_event_start(u64 next_event)
 {
-	u32 target_hart = current_hartid();
-	struct sbi_scratch *scratch;
+	struct sbi_scratch *scratch = sbi_scratch_thishart_ptr();
 	struct aclint_mtimer_data *mt;
-	u64 *time_cmp;
-
-	scratch = sbi_hartid_to_scratch(target_hart);
-	if (!scratch)
-		return;
 
 	mt = mtimer_get_hart_data_ptr(scratch);
-	if (!mt)
+	if (!mt || !scratch->hot.timecmp_addr)
 		return;
 
 	/* Program MTIMER Time Compare */
-	time_cmp = (void *)mt->mtimecmp_addr;
-	mt->time_wr(true, next_event,
-		    &time_cmp[target_hart - mt->first_hartid]);
+	mt->time_wr(true, next_event, (void *)scratch->hot.timecmp_addr);
 }
 
 static struct sbi_timer_device mtimer = {
@@ -117,6 +105,52 @@ static struct sbi_timer_device mtimer = {
 	.timer_event_stop = mtimer_event_stop
 };
 
+#ifdef CONFIG_TIMER_MTIMER_SHARED_MTIME
+static int mtimer_share_mtime(struct aclint_mtimer_data *mt)
+{
+	struct sbi_domain_memregion reg;
+	unsigned long base, order;
+	int rc;
+
+	/* Only the first MTIME is shared, others are synced to it */
+	if (mtimer.smode_time_addr || !mt->mtime_size)
+		return 0;
+
+	order = log2roundup(sbi_hart_pmp_granularity(
+					sbi_scratch_thishart_ptr()));
+	if (order < 3)
+		order = 3;
+	base = mt->mtime_addr & ~(BIT(order) - 1);
+
+	/* Never expose MTIMECMP registers to S-mode */
+	if (base < (mt->mtimecmp_addr + mt->mtimecmp_size) &&
+	    mt->mtimecmp_addr < (base + BIT(order))) {
+		sbi_printf("%s: MTIME 0x%lx shares PMP granule with "
+			   "MTIMECMP so not sharing it\n",
+			   __func__, mt->mtime_addr);
+		return 0;
+	}
+
+	sbi_domain_memregion_init(base, BIT(order),
+				  (SBI_DOMAIN_MEMREGION_MMIO |
+				   SBI_DOMAIN_MEMREGION_M_READABLE |
+				   SBI_DOMAIN_MEMREGION_M_WRITABLE |
+				   SBI_DOMAIN_MEMREGION_SU_READABLE),
+				  &reg);
+	rc = sbi_domain_root_add_memregion(&reg);
+	if (rc)
+		return rc;
+
+	mtimer.smode_time_addr = mt->mtime_addr;
+	return 0;
+}
+#else
+static inline int mtimer_share_mtime(struct aclint_mtimer_data *mt)
+{
+	return 0;
+}
+#endif
+
 void aclint_mtimer_sync(struct aclint_mtimer_data *mt)
 {
 	u64 v1, v2, mv, delta;
@@ -169,10 +203,13 @@ int aclint_mtimer_warm_init(void)
 	/* Sync-up MTIME register */
 	aclint_mtimer_sync(mt);
 
-	/* Clear Time Compare */
+	/* Cache Time Compare address in the hot context */
 	mt_time_cmp = (void *)mt->mtimecmp_addr;
-	mt->time_wr(true, -1ULL,
-		    &mt_time_cmp[target_hart - mt->first_hartid]);
+	scratch->hot.timecmp_addr =
+		(unsigned long)&mt_time_cmp[target_hart - mt->first_hartid];
+
+	/* Clear Time Compare */
+	mt->time_wr(true, -1ULL, (void *)scratch->hot.timecmp_addr);
 
 	return 0;
 }
@@ -271,6 +308,11 @@ int aclint_mtimer_cold_init(struct aclint_mtimer_data *mt,
 			return rc;
 	}
 
+	/* Optionally let S-mode read MTIME directly */
+	rc = mtimer_share_mtime(mt);
+	if (rc)
+		return rc;
+
 	mtimer.timer_freq = mt->mtime_freq;
 	sbi_timer_set_device(&mtimer);
 
@@ -189,10 +189,24 @@ static void sun20i_d1_hart_resume(void)
 	sun20i_d1_plic_restore();
 }
 
+/*
+ * Same state as the "cpu-nonretentive" entry of sun20i_d1_cpu_idle_states
+ * below: latency is its entry_latency_us (40) plus exit_latency_us (67).
+ */
+static const struct sbi_hsm_idle_state sun20i_d1_hsm_idle_states[] = {
+	{
+		.suspend_type		= SBI_HSM_SUSPEND_NON_RET_DEFAULT,
+		.latency_us		= 40 + 67,
+		.min_residency_us	= 1100,
+	},
+};
+
 static const struct sbi_hsm_device sun20i_d1_ppu = {
-	.name		= "sun20i-d1-ppu",
-	.hart_suspend	= sun20i_d1_hart_suspend,
-	.hart_resume	= sun20i_d1_hart_resume,
+	.name			= "sun20i-d1-ppu",
+	.hart_suspend		= sun20i_d1_hart_suspend,
+	.hart_resume		= sun20i_d1_hart_resume,
+	.idle_states		= sun20i_d1_hsm_idle_states,
+	.idle_state_count	= array_size(sun20i_d1_hsm_idle_states),
 };
 
 static int sun20i_d1_final_init(bool cold_boot, const struct fdt_match *match)
@@ -10,6 +10,7 @@
 #include <libfdt.h>
 #include <platform_override.h>
 #include <sbi/riscv_asm.h>
+#include <sbi/sbi_domain.h>
 #include <sbi/sbi_hartmask.h>
 #include <sbi/sbi_platform.h>
 #include <sbi/sbi_string.h>
@@ -78,7 +79,7 @@ unsigned long fw_platform_init(unsigned long arg0, unsigned long arg1,
 	const char *model;
 	void *fdt = (void *)arg1;
 	u32 hartid, hart_count = 0;
-	int rc, root_offset, cpus_offset, cpu_offset, len;
+	int rc, root_offset, cpus_offset, cpu_offset, chosen_offset, len;
 
 	root_offset = fdt_path_offset(fdt, "/");
 	if (root_offset < 0)
@@ -96,6 +97,12 @@ unsigned long fw_platform_init(unsigned long arg0, unsigned long arg1,
 	if (generic_plat && generic_plat->features)
 		platform.features = generic_plat->features(generic_plat_match);
 
+	/* Only parts known to have identical HARTs share probed features */
+	chosen_offset = fdt_path_offset(fdt, "/chosen");
+	if (chosen_offset >= 0 &&
+	    fdt_getprop(fdt, chosen_offset, "opensbi,hart-feature-cache", NULL))
+		platform.features |= SBI_PLATFORM_HAS_HART_FEATURE_CACHE;
+
 	cpus_offset = fdt_path_offset(fdt, "/cpus");
 	if (cpus_offset < 0)
 		goto fail;
@@ -230,7 +237,8 @@ static int generic_extensions_init(struct sbi_hart_features *hfeatures)
 static int generic_domains_init(void)
 {
 	void *fdt = fdt_get_address();
-	int offset, ret;
+	const fdt32_t *val;
+	int offset, ret, len;
 
 	ret = fdt_domains_populate(fdt);
 	if (ret < 0)
@@ -244,6 +252,14 @@ static int generic_domains_init(void)
 		if (offset >= 0 &&
 		    fdt_get_property(fdt, offset, "system-suspend-test", NULL))
 			sbi_system_suspend_test_enable();
+
+		/* The ROOT domain has no domain instance DT node */
+		if (offset >= 0) {
+			val = fdt_getprop(fdt, offset,
+					  "root-timer-slack-us", &len);
+			if (val && len >= 4)
+				root.timer_slack_us = fdt32_to_cpu(val[0]);
+		}
 	}
 
 	return 0;